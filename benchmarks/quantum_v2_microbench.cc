@@ -0,0 +1,427 @@
+#include "ns3/core-module.h"
+
+#include "quantum_v2/2_qubit.h"
+#include "quantum_v2/2_quantum_component.h"
+#include "quantum_v2/2_quantum_channel.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for the quantum_v2 hot paths. Each benchmark is swept
+// over its parameters and prints one JSON object per configuration (JSON
+// Lines) with the time, heap allocations and allocated bytes per
+// operation. Setup and teardown run with the clock and the allocation
+// counters paused. Output from the simulation itself is discarded.
+//
+//   quantum_v2_microbench [--filter=<substring>] [--min-time=<seconds>]
+
+using namespace ns3;
+
+// ---------------------------------------------------------------------------
+// Allocation counting: every global operator new goes through these two
+// ---------------------------------------------------------------------------
+namespace {
+std::atomic<uint64_t> g_allocs{0};
+std::atomic<uint64_t> g_bytes{0};
+}
+
+void* operator new(std::size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    const std::size_t a = static_cast<std::size_t>(align);
+    if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a))
+        return p;
+    throw std::bad_alloc();
+}
+
+// GCC cannot tell these replace the allocation functions above
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Params = std::vector<std::pair<std::string, int64_t>>;
+
+// Drives the timed loop of one benchmark configuration, in the style of
+// google-benchmark: while (state.keep_running()) { ... }. The loop runs
+// until min_time of unpaused time has passed.
+class State {
+public:
+    explicit State(double min_time) : min_time_(min_time) {}
+
+    bool keep_running() {
+        if (iterations_ == 0) {
+            start();
+        } else if (iterations_ % kCheckEvery == 0 && !paused_ && elapsed() >= min_time_) {
+            stop();
+            return false;
+        }
+        ++iterations_;
+        return true;
+    }
+
+    void pause() {
+        paused_at_ = Clock::now();
+        allocs_ += g_allocs.load(std::memory_order_relaxed) - allocs_at_;
+        bytes_ += g_bytes.load(std::memory_order_relaxed) - bytes_at_;
+        paused_ = true;
+    }
+
+    void resume() {
+        paused_for_ += Clock::now() - paused_at_;
+        allocs_at_ = g_allocs.load(std::memory_order_relaxed);
+        bytes_at_ = g_bytes.load(std::memory_order_relaxed);
+        paused_ = false;
+    }
+
+    // Operations done per loop iteration, when one iteration does several
+    void set_ops_per_iteration(uint64_t ops) { ops_per_iteration_ = ops; }
+
+    uint64_t ops() const { return iterations_ * ops_per_iteration_; }
+    double seconds() const { return std::chrono::duration<double>(end_ - start_ - paused_for_).count(); }
+    uint64_t allocs() const { return allocs_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    static constexpr uint64_t kCheckEvery = 16;
+
+    void start() {
+        paused_for_ = Clock::duration::zero();
+        allocs_ = bytes_ = 0;
+        allocs_at_ = g_allocs.load(std::memory_order_relaxed);
+        bytes_at_ = g_bytes.load(std::memory_order_relaxed);
+        start_ = Clock::now();
+    }
+
+    void stop() {
+        end_ = Clock::now();
+        allocs_ += g_allocs.load(std::memory_order_relaxed) - allocs_at_;
+        bytes_ += g_bytes.load(std::memory_order_relaxed) - bytes_at_;
+    }
+
+    double elapsed() const {
+        return std::chrono::duration<double>(Clock::now() - start_ - paused_for_).count();
+    }
+
+    double min_time_;
+    uint64_t iterations_ = 0;
+    uint64_t ops_per_iteration_ = 1;
+    bool paused_ = false;
+    Clock::time_point start_, end_, paused_at_;
+    Clock::duration paused_for_{};
+    uint64_t allocs_ = 0, bytes_ = 0, allocs_at_ = 0, bytes_at_ = 0;
+};
+
+struct Options {
+    std::string filter;
+    double min_time = 0.2;
+};
+
+std::ostream* g_out = &std::cout;
+
+template <typename Body>
+void Run(const Options& options, const std::string& name, const Params& params, Body body) {
+    if (name.find(options.filter) == std::string::npos)
+        return;
+    State state(options.min_time);
+    body(state);
+    Simulator::Destroy();
+
+    const double ops = static_cast<double>(state.ops());
+    std::ostringstream line;
+    line << "{\"benchmark\":\"" << name << "\",\"params\":{";
+    for (size_t i = 0; i < params.size(); ++i)
+        line << (i ? "," : "") << "\"" << params[i].first << "\":" << params[i].second;
+    line << "},\"ops\":" << state.ops()
+         << ",\"ns_per_op\":" << state.seconds() * 1e9 / ops
+         << ",\"allocs_per_op\":" << state.allocs() / ops
+         << ",\"bytes_per_op\":" << state.bytes() / ops << "}\n";
+    *g_out << line.str() << std::flush;
+}
+
+// n qubits of component c in one entanglement group (a GHZ state)
+std::vector<std::shared_ptr<Qubit>> MakeGroup(Ptr<QuantumComponent> c, size_t n) {
+    std::vector<std::shared_ptr<Qubit>> qs;
+    for (size_t i = 0; i < n; ++i)
+        qs.push_back(c->CreateQubit());
+    c->ApplyGate(Gate::H, qs[0]);
+    for (size_t i = 1; i < n; ++i)
+        c->ApplyGate(Gate::CNOT, {qs[0], qs[i]});
+    qs[0]->state()->flush();
+    return qs;
+}
+
+void Drop(Ptr<QuantumComponent> c, std::vector<std::shared_ptr<Qubit>>& qs) {
+    for (const auto& q : qs)
+        c->RemoveQubit(q);
+    qs.clear();
+}
+
+// Component already holding the given number of separate qubits, so store
+// and registry sizes can be part of a sweep
+Ptr<QuantumComponent> MakeComponent(size_t qubits) {
+    Ptr<QuantumComponent> c = CreateObject<QuantumComponent>();
+    for (size_t i = 0; i < qubits; ++i)
+        c->CreateQubit();
+    return c;
+}
+
+void BenchApplyGate(const Options& options) {
+    for (int64_t n : {1, 4, 8, 12, 16, 20}) {
+        // One layer is a gate on each qubit, so the lazy queue can fuse
+        // within a layer but its flush at the end of each layer is timed
+        Run(options, "apply_gate_1q", {{"state_qubits", n}}, [&](State& state) {
+            auto c = MakeComponent(0);
+            auto qs = MakeGroup(c, n);
+            const Gate gates[] = {Gate::H, Gate::T};
+            size_t i = 0;
+            while (state.keep_running()) {
+                c->ApplyGate(gates[(i / n) % 2], qs[i % n]);
+                if (++i % n == 0)
+                    qs[0]->state()->flush();
+            }
+        });
+        if (n < 2)
+            continue;
+        Run(options, "apply_gate_2q", {{"state_qubits", n}}, [&](State& state) {
+            auto c = MakeComponent(0);
+            auto qs = MakeGroup(c, n);
+            size_t i = 0;
+            while (state.keep_running()) {
+                c->ApplyGate(Gate::CNOT, {qs[i % n], qs[(i + 1) % n]});
+                if (++i % n == 0)
+                    qs[0]->state()->flush();
+            }
+        });
+    }
+
+    // A two-qubit gate across two groups of group_qubits each, which merges them
+    for (int64_t k : {1, 2, 4, 8, 10}) {
+        Run(options, "apply_gate_merge", {{"group_qubits", k}}, [&](State& state) {
+            auto c = MakeComponent(0);
+            while (state.keep_running()) {
+                state.pause();
+                auto a = MakeGroup(c, k);
+                auto b = MakeGroup(c, k);
+                state.resume();
+                c->ApplyGate(Gate::CNOT, {a[0], b[0]});
+                a[0]->state()->flush();
+                state.pause();
+                Drop(c, a);
+                Drop(c, b);
+                state.resume();
+            }
+        });
+    }
+}
+
+void BenchMeasure(const Options& options) {
+    for (int64_t n : {1, 2, 4, 8, 12, 16}) {
+        Run(options, "measure", {{"state_qubits", n}}, [&](State& state) {
+            auto c = MakeComponent(0);
+            while (state.keep_running()) {
+                state.pause();
+                auto qs = MakeGroup(c, n);
+                state.resume();
+                c->Measure(qs[0]);
+                state.pause();
+                Drop(c, qs);
+                state.resume();
+            }
+        });
+    }
+}
+
+void BenchCreateEntangledPair(const Options& options) {
+    for (int64_t held : {0, 100, 10000}) {
+        Run(options, "create_entangled_pair", {{"node_qubits", held}}, [&](State& state) {
+            auto c = MakeComponent(held);
+            while (state.keep_running()) {
+                auto [a, b] = c->CreateEntangledPair();
+                state.pause();
+                c->RemoveQubit(a);
+                c->RemoveQubit(b);
+                a.reset();
+                b.reset();
+                state.resume();
+            }
+        });
+    }
+}
+
+void BenchRegistry(const Options& options) {
+    // Register and unregister a lone qubit next to live other qubits
+    for (int64_t live : {0, 1000, 100000}) {
+        Run(options, "registry_acquire_release", {{"live_qubits", live}}, [&](State& state) {
+            Ptr<QuantumStateRegistry> registry = CreateObject<QuantumStateRegistry>();
+            std::vector<std::shared_ptr<Qubit>> others;
+            for (int64_t i = 0; i < live; ++i)
+                others.push_back(Qubit::Create(registry, 0, std::make_shared<QuantumState>(1)));
+            auto state1 = std::make_shared<QuantumState>(1);
+            while (state.keep_running()) {
+                auto q = Qubit::Create(registry, 0, state1);
+                q.reset();
+                state.pause();
+                state1 = std::make_shared<QuantumState>(1);
+                state.resume();
+            }
+        });
+    }
+
+    // Unregister one qubit of a group; the default discard policy measures it out
+    for (int64_t k : {2, 4, 8, 12, 16}) {
+        Run(options, "registry_release_entangled", {{"group_qubits", k}}, [&](State& state) {
+            auto c = MakeComponent(0);
+            while (state.keep_running()) {
+                state.pause();
+                auto qs = MakeGroup(c, k);
+                for (const auto& q : qs)
+                    c->RemoveQubit(q);
+                auto last = qs.back();
+                qs.pop_back();
+                state.resume();
+                last.reset();
+                state.pause();
+                qs.clear();
+                state.resume();
+            }
+        });
+    }
+}
+
+void BenchTransmit(const Options& options) {
+    // Scheduling only; the queue is drained, untimed, every batch qubits
+    for (int64_t pending : {16, 1024, 65536}) {
+        Run(options, "channel_transmit", {{"pending_events", pending}}, [&](State& state) {
+            auto a = MakeComponent(0);
+            auto b = MakeComponent(0);
+            Ptr<QuantumChannel> channel = CreateObject<QuantumChannel>();
+            channel->SetDelay(MicroSeconds(10));
+            channel->Connect(a, b);
+            int64_t queued = 0;
+            while (state.keep_running()) {
+                state.pause();
+                auto q = a->CreateQubit();
+                a->RemoveQubit(q);
+                state.resume();
+                channel->Transmit(q);
+                state.pause();
+                q.reset();
+                if (++queued == pending) {
+                    Simulator::Run();
+                    queued = 0;
+                }
+                state.resume();
+            }
+        });
+    }
+
+    // Delivery: running the events of a batch of transmitted qubits
+    Run(options, "channel_deliver", {{"batch", 1024}}, [&](State& state) {
+        auto a = MakeComponent(0);
+        auto b = MakeComponent(0);
+        Ptr<QuantumChannel> channel = CreateObject<QuantumChannel>();
+        channel->SetDelay(MicroSeconds(10));
+        channel->Connect(a, b);
+        state.set_ops_per_iteration(1024);
+        while (state.keep_running()) {
+            state.pause();
+            for (int i = 0; i < 1024; ++i) {
+                auto q = a->CreateQubit();
+                a->RemoveQubit(q);
+                channel->Transmit(q);
+            }
+            state.resume();
+            Simulator::Run();
+            state.pause();
+            b = MakeComponent(0);
+            channel->Connect(a, b);
+            state.resume();
+        }
+    });
+
+    // The same 1024 qubits sent and delivered as trains of the given length,
+    // one event each
+    for (int64_t length : {1, 64, 1024}) {
+        Run(options, "channel_transmit_train", {{"train_qubits", length}}, [&](State& state) {
+            auto a = MakeComponent(0);
+            auto b = MakeComponent(0);
+            Ptr<QuantumChannel> channel = CreateObject<QuantumChannel>();
+            channel->SetDelay(MicroSeconds(10));
+            channel->Connect(a, b);
+            state.set_ops_per_iteration(1024);
+            while (state.keep_running()) {
+                state.pause();
+                std::vector<QubitTrain> trains(1024 / length);
+                for (auto& train : trains) {
+                    for (int64_t i = 0; i < length; ++i) {
+                        auto q = a->CreateQubit();
+                        a->RemoveQubit(q);
+                        train.qubits.push_back(q);
+                        train.offsets.push_back(NanoSeconds(i));
+                    }
+                }
+                state.resume();
+                for (auto& train : trains)
+                    channel->TransmitTrain(std::move(train));
+                Simulator::Run();
+                state.pause();
+                trains.clear();
+                b = MakeComponent(0);
+                channel->Connect(a, b);
+                state.resume();
+            }
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--filter=", 9) == 0) {
+            options.filter = argv[i] + 9;
+        } else if (std::strncmp(argv[i], "--min-time=", 11) == 0) {
+            options.min_time = std::atof(argv[i] + 11);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--filter=<substring>] [--min-time=<seconds>]\n";
+            return 1;
+        }
+    }
+
+    // Results go to the real stdout; the simulation's own logging is dropped
+    std::ostream results(std::cout.rdbuf());
+    g_out = &results;
+    std::cout.setstate(std::ios::badbit);
+
+    BenchApplyGate(options);
+    BenchMeasure(options);
+    BenchCreateEntangledPair(options);
+    BenchRegistry(options);
+    BenchTransmit(options);
+
+    std::cout.clear();
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include "quantum_v2/2_qubit.h"
+#include "quantum_v2/2_quantum_component.h"
+#include "quantum_v2/2_quantum_channel.h"
+#include "quantum_v2/2_quantum_net_device.h"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// End-to-end scaling benchmarks on whole topologies built from
+// QuantumComponent, QuantumNetDevice and QuantumChannel:
+//
+//   chain — N nodes in a line; every link distributes a Bell pair, the inner
+//           nodes swap, and the end node applies the heralded corrections
+//   star  — N clients each teleport a qubit to a hub over a pair it shared
+//   p2p   — one link carrying N qubits emitted at a fixed rate
+//
+// Each size runs in a forked process of its own, so the peak RSS reported
+// belongs to that size alone. One JSON object per configuration (JSON
+// Lines): setup and run wall time, events executed, events per second of
+// run time, simulated time, sends refused by a full transmit queue and peak
+// RSS. Output from the simulation itself is discarded. A refused qubit is
+// dropped, so a nonzero count means a chain or star round never finished.
+
+using namespace ns3;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Link {
+    Ptr<QuantumComponent> from;
+    Ptr<QuantumComponent> to;
+    Ptr<QuantumNetDevice> device; // on from's node
+};
+
+// Node with a component sharing registry; links are added by Connect
+Ptr<QuantumComponent> AddNode(Ptr<QuantumStateRegistry> registry) {
+    Ptr<Node> node = CreateObject<Node>();
+    Ptr<QuantumComponent> component = CreateObject<QuantumComponent>();
+    component->SetAttribute("Registry", PointerValue(registry));
+    node->AggregateObject(component);
+    return component;
+}
+
+// One-way quantum link from -> to
+Link Connect(Ptr<QuantumComponent> from, Ptr<QuantumComponent> to, Time delay) {
+    Ptr<QuantumNetDevice> tx = CreateObject<QuantumNetDevice>();
+    Ptr<QuantumNetDevice> rx = CreateObject<QuantumNetDevice>();
+    from->AddDevice(tx);
+    to->AddDevice(rx);
+    Ptr<QuantumChannel> channel = CreateObject<QuantumChannel>();
+    channel->SetDelay(delay);
+    channel->Connect(from, to);
+    tx->Attach(channel);
+    rx->Attach(channel);
+    return {from, to, tx};
+}
+
+// Sends q over link, dropping it at the sender if the device refuses it
+bool Send(const Link& link, std::shared_ptr<Qubit> q) {
+    if (link.device->SendQubit(q))
+        return true;
+    link.from->RemoveQubit(q);
+    return false;
+}
+
+// Linear chain of n nodes running `rounds` rounds of entanglement
+// distribution. Inner node j swaps the pair arriving from the left with its
+// own pair to the right (Bell measurement) and heralds the outcome to the
+// last node, which applies the accumulated Pauli correction once every
+// swap has been heard from; the next round then starts.
+class Chain {
+public:
+    Chain(uint32_t nodes, uint32_t rounds, Time delay) : m_rounds(rounds), m_delay(delay) {
+        Ptr<QuantumStateRegistry> registry = CreateObject<QuantumStateRegistry>();
+        for (uint32_t i = 0; i < nodes; ++i)
+            m_nodes.push_back(AddNode(registry));
+        for (uint32_t i = 0; i + 1 < nodes; ++i)
+            m_links.push_back(Connect(m_nodes[i], m_nodes[i + 1], delay));
+        m_left.resize(nodes);
+        m_right.resize(nodes);
+        for (uint32_t i = 1; i < nodes; ++i)
+            m_nodes[i]->SetReceiveCallback([this, i](std::shared_ptr<Qubit> q) { Arrive(i, q); });
+    }
+
+    void Start() { Simulator::ScheduleNow(&Chain::Round, this); }
+    uint64_t Rejected() const { return m_rejected; }
+
+private:
+    void Round() {
+        m_arrived = 0;
+        m_heard = 0;
+        m_x = m_z = 0;
+        for (uint32_t i = 0; i < m_links.size(); ++i) {
+            auto [a, b] = m_nodes[i]->CreateEntangledPair();
+            b->set_id("from_left");
+            m_right[i] = a;
+            if (!Send(m_links[i], b))
+                ++m_rejected;
+        }
+    }
+
+    // Also called for the pair a node creates itself, which stays put
+    void Arrive(uint32_t node, std::shared_ptr<Qubit> q) {
+        if (q->get_id() != "from_left")
+            return;
+        m_left[node] = q;
+        if (++m_arrived < m_links.size())
+            return;
+        if (m_nodes.size() == 2) {
+            Corrected();
+            return;
+        }
+        for (uint32_t j = 1; j + 1 < m_nodes.size(); ++j)
+            Swap(j);
+    }
+
+    void Swap(uint32_t j) {
+        Ptr<QuantumComponent> c = m_nodes[j];
+        auto l = m_left[j], r = m_right[j];
+        auto m = c->SwapEntanglement(l, r);
+        c->RemoveQubit(l);
+        c->RemoveQubit(r);
+        m_left[j].reset();
+        m_right[j].reset();
+        const Time herald = m_delay * static_cast<int64_t>(m_nodes.size() - 1 - j);
+        Simulator::Schedule(herald, &Chain::Herald, this, m[0], m[1]);
+    }
+
+    void Herald(qpp::idx z, qpp::idx x) {
+        m_z ^= z;
+        m_x ^= x;
+        if (++m_heard == m_nodes.size() - 2)
+            Corrected();
+    }
+
+    void Corrected() {
+        Ptr<QuantumComponent> end = m_nodes.back();
+        auto q = m_left.back();
+        if (m_x)
+            end->ApplyGate(Gate::X, q);
+        if (m_z)
+            end->ApplyGate(Gate::Z, q);
+        end->RemoveQubit(q);
+        m_nodes.front()->RemoveQubit(m_right.front());
+        m_left.back().reset();
+        m_right.front().reset();
+        if (++m_done < m_rounds)
+            Simulator::ScheduleNow(&Chain::Round, this);
+    }
+
+    uint32_t m_rounds;
+    Time m_delay;
+    std::vector<Ptr<QuantumComponent>> m_nodes;
+    std::vector<Link> m_links;
+    std::vector<std::shared_ptr<Qubit>> m_left;  // pair half received from the left
+    std::vector<std::shared_ptr<Qubit>> m_right; // pair half kept for the right
+    uint32_t m_arrived = 0, m_heard = 0, m_done = 0;
+    qpp::idx m_x = 0, m_z = 0;
+    uint64_t m_rejected = 0;
+};
+
+// Star of n clients around a hub. Each round the hub sends every client
+// half of a fresh pair; on arrival the client teleports a qubit to the hub
+// and sends its two bits back, and the hub applies the correction.
+class Star {
+public:
+    Star(uint32_t clients, uint32_t rounds, Time delay) : m_rounds(rounds), m_delay(delay) {
+        Ptr<QuantumStateRegistry> registry = CreateObject<QuantumStateRegistry>();
+        m_hub = AddNode(registry);
+        for (uint32_t i = 0; i < clients; ++i) {
+            Ptr<QuantumComponent> client = AddNode(registry);
+            m_links.push_back(Connect(m_hub, client, delay));
+            client->SetReceiveCallback([this, i](std::shared_ptr<Qubit> q) { Teleport(i, q); });
+        }
+        m_kept.resize(clients);
+    }
+
+    void Start() { Simulator::ScheduleNow(&Star::Round, this); }
+    uint64_t Rejected() const { return m_rejected; }
+
+private:
+    void Round() {
+        m_corrected = 0;
+        for (uint32_t i = 0; i < m_links.size(); ++i) {
+            auto [a, b] = m_hub->CreateEntangledPair();
+            m_kept[i] = a;
+            if (!Send(m_links[i], b))
+                ++m_rejected;
+        }
+    }
+
+    void Teleport(uint32_t i, std::shared_ptr<Qubit> half) {
+        Ptr<QuantumComponent> c = m_links[i].to;
+        auto psi = c->CreateQubit();
+        c->ApplyGate(Gate::X, psi);
+        c->ApplyGate(Gate::H, psi);
+        c->ApplyGate(Gate::CNOT, {psi, half});
+        c->ApplyGate(Gate::H, psi);
+        auto m = c->Measure({psi, half});
+        c->RemoveQubit(psi);
+        c->RemoveQubit(half);
+        Simulator::Schedule(m_delay, &Star::Correct, this, i, m[0], m[1]);
+    }
+
+    void Correct(uint32_t i, qpp::idx z, qpp::idx x) {
+        auto q = m_kept[i];
+        if (x)
+            m_hub->ApplyGate(Gate::X, q);
+        if (z)
+            m_hub->ApplyGate(Gate::Z, q);
+        m_hub->RemoveQubit(q);
+        m_kept[i].reset();
+        if (++m_corrected == m_links.size() && ++m_done < m_rounds)
+            Simulator::ScheduleNow(&Star::Round, this);
+    }
+
+    uint32_t m_rounds;
+    Time m_delay;
+    Ptr<QuantumComponent> m_hub;
+    std::vector<Link> m_links;
+    std::vector<std::shared_ptr<Qubit>> m_kept;
+    uint32_t m_corrected = 0, m_done = 0;
+    uint64_t m_rejected = 0;
+};
+
+// A source emitting n qubits at rate_hz down one link; the receiver
+// discards each on arrival
+class PointToPoint {
+public:
+    PointToPoint(uint32_t qubits, double rate_hz, Time delay)
+        : m_qubits(qubits), m_period(Seconds(1.0 / rate_hz)) {
+        Ptr<QuantumStateRegistry> registry = CreateObject<QuantumStateRegistry>();
+        m_link = Connect(AddNode(registry), AddNode(registry), delay);
+        m_link.to->SetReceiveCallback([this](std::shared_ptr<Qubit> q) { m_link.to->RemoveQubit(q); });
+    }
+
+    void Start() { Simulator::ScheduleNow(&PointToPoint::Emit, this); }
+    uint64_t Rejected() const { return m_rejected; }
+
+private:
+    void Emit() {
+        auto q = m_link.from->CreateQubit();
+        m_link.from->ApplyGate(Gate::H, q);
+        if (!Send(m_link, q))
+            ++m_rejected;
+        if (++m_sent < m_qubits)
+            Simulator::Schedule(m_period, &PointToPoint::Emit, this);
+    }
+
+    uint32_t m_qubits;
+    Time m_period;
+    Link m_link;
+    uint32_t m_sent = 0;
+    uint64_t m_rejected = 0;
+};
+
+struct Result {
+    double setup_s = 0;
+    double run_s = 0;
+    uint64_t events = 0;
+    double sim_s = 0;
+    uint64_t rejected = 0;
+};
+
+template <typename Scenario, typename... Args>
+Result RunScenario(Args... args) {
+    Result r;
+    const auto t0 = Clock::now();
+    {
+        Scenario scenario(args...);
+        scenario.Start();
+        const auto t1 = Clock::now();
+        Simulator::Run();
+        const auto t2 = Clock::now();
+        r.setup_s = std::chrono::duration<double>(t1 - t0).count();
+        r.run_s = std::chrono::duration<double>(t2 - t1).count();
+        r.events = Simulator::GetEventCount();
+        r.sim_s = Simulator::Now().GetSeconds();
+        r.rejected = scenario.Rejected();
+    }
+    Simulator::Destroy();
+    return r;
+}
+
+// Runs run() in a child process and prints its result with the child's
+// peak RSS
+template <typename F>
+void Report(std::ostream& out, const std::string& name, const std::string& size_name, uint64_t size, F run) {
+    out.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        const Result r = run();
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        std::ostringstream line;
+        line << "{\"benchmark\":\"" << name << "\",\"params\":{\"" << size_name << "\":" << size << "}"
+             << ",\"setup_s\":" << r.setup_s << ",\"run_s\":" << r.run_s
+             << ",\"events\":" << r.events << ",\"events_per_s\":" << r.events / r.run_s
+             << ",\"sim_s\":" << r.sim_s << ",\"rejected_sends\":" << r.rejected
+             << ",\"peak_rss_kb\":" << usage.ru_maxrss << "}\n";
+        out << line.str() << std::flush;
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        std::cerr << name << " with " << size_name << "=" << size << " failed\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string scenario = "all";
+    uint32_t maxNodes = 1024;
+    uint32_t maxQubits = 1000000;
+    uint32_t rounds = 10;
+    double rateHz = 1e6;
+    Time delay = MicroSeconds(5);
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("scenario", "chain, star, p2p or all", scenario);
+    cmd.AddValue("maxNodes", "Largest chain length and star size in the sweep", maxNodes);
+    cmd.AddValue("maxQubits", "Largest number of qubits sent in the p2p sweep", maxQubits);
+    cmd.AddValue("rounds", "Distribution rounds per chain and star run", rounds);
+    cmd.AddValue("rate", "p2p emission rate in Hz", rateHz);
+    cmd.AddValue("delay", "Per-link propagation delay", delay);
+    cmd.Parse(argc, argv);
+
+    // Results go to the real stdout; the simulation's own logging is dropped
+    std::ostream results(std::cout.rdbuf());
+    std::cout.setstate(std::ios::badbit);
+
+    if (scenario == "all" || scenario == "chain") {
+        for (uint32_t n = 2; n <= maxNodes; n *= 2)
+            Report(results, "chain", "nodes", n, [&] { return RunScenario<Chain>(n, rounds, delay); });
+    }
+    if (scenario == "all" || scenario == "star") {
+        for (uint32_t n = 1; n <= maxNodes; n *= 2)
+            Report(results, "star", "clients", n, [&] { return RunScenario<Star>(n, rounds, delay); });
+    }
+    if (scenario == "all" || scenario == "p2p") {
+        for (uint32_t n = 1000; n <= maxQubits; n *= 10)
+            Report(results, "p2p", "qubits", n, [&] { return RunScenario<PointToPoint>(n, rateHz, delay); });
+    }
+
+    std::cout.clear();
+    return 0;
+}
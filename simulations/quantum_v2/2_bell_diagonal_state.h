@@ -0,0 +1,144 @@
+#pragma once
+#include "qpp/qpp.hpp"
+#include "2_gate.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// Two qubits in a mixture of Bell states, ρ = Σ_k w_k |B_k⟩⟨B_k|, stored as
+// the four weights alone. Bell state k is (I ⊗ P)|Φ+⟩ for the Pauli P whose
+// (x, z) bits make up k = 2x + z, giving Φ+, Φ−, Ψ+, Ψ−. A Pauli on either
+// qubit permutes the Bell states (up to phase) by XOR-ing its bits into k,
+// so Pauli corrections and Pauli channels, i.e. depolarizing, dephasing and
+// twirling, are closed-form updates of the weights. Werner states are the
+// ones with equal weights on Φ−, Ψ+ and Ψ−.
+class BellDiagonalState {
+public:
+    enum Bell { PHI_PLUS, PHI_MINUS, PSI_PLUS, PSI_MINUS };
+    // Probabilities of the single-qubit Paulis, indexed by their (x, z) bits
+    // like the Bell states: I, Z, X, Y
+    using PauliProbabilities = std::array<double, 4>;
+
+    explicit BellDiagonalState(Bell bell = PHI_PLUS);
+    explicit BellDiagonalState(const std::array<double, 4>& weights);
+    // Fidelity F with Φ+ and the rest spread evenly
+    static BellDiagonalState werner(double fidelity);
+    // The weights of a two-qubit density matrix on the Bell states, i.e. the
+    // state a full twirl would leave it in
+    static BellDiagonalState from_density_matrix(const qpp::cmat& rho);
+
+    const std::array<double, 4>& weights() const { return weights_; }
+    double fidelity(Bell bell = PHI_PLUS) const { return weights_[bell]; }
+    // Whether all the weight is on one Bell state, which is then returned
+    bool is_pure(Bell* bell = nullptr) const;
+
+    // Pauli with bits (x, z) on either qubit
+    void apply_pauli(bool x, bool z);
+    // Applies gate if it keeps the state Bell-diagonal: a Pauli on either
+    // qubit, or SWAP, which fixes every Bell state up to sign. Returns false,
+    // leaving the state untouched, otherwise.
+    bool apply_gate(const Gate& gate);
+    // The channel ρ → Σ_P p_P P ρ P on either qubit
+    void apply_pauli_channel(const PauliProbabilities& probabilities);
+    // p/3 each of X, Y and Z, as in QuantumErrorModel
+    void depolarize(double p);
+    void dephase(double p);
+    // Random bilateral rotation: keeps the Φ+ weight and spreads the rest
+    // evenly, leaving a Werner state of the same fidelity
+    void twirl();
+
+    static qpp::ket bell_ket(Bell bell);
+    qpp::cmat to_density_matrix() const;
+
+private:
+    std::array<double, 4> weights_;
+};
+
+
+// ----------- Inline implementations ------------
+inline BellDiagonalState::BellDiagonalState(Bell bell) : weights_{} {
+    weights_[bell] = 1;
+}
+
+inline BellDiagonalState::BellDiagonalState(const std::array<double, 4>& weights) : weights_(weights) {}
+
+inline BellDiagonalState BellDiagonalState::werner(double fidelity) {
+    const double rest = (1 - fidelity) / 3;
+    return BellDiagonalState({fidelity, rest, rest, rest});
+}
+
+inline BellDiagonalState BellDiagonalState::from_density_matrix(const qpp::cmat& rho) {
+    std::array<double, 4> weights;
+    for (int k = 0; k < 4; ++k) {
+        const qpp::ket b = bell_ket(static_cast<Bell>(k));
+        weights[k] = (b.adjoint() * rho * b)(0, 0).real();
+    }
+    return BellDiagonalState(weights);
+}
+
+inline bool BellDiagonalState::is_pure(Bell* bell) const {
+    const auto it = std::max_element(weights_.begin(), weights_.end());
+    if (bell)
+        *bell = static_cast<Bell>(it - weights_.begin());
+    return *it > 1 - 1e-12;
+}
+
+inline void BellDiagonalState::apply_pauli(bool x, bool z) {
+    const int j = (x << 1) | z;
+    std::array<double, 4> w;
+    for (int k = 0; k < 4; ++k)
+        w[k ^ j] = weights_[k];
+    weights_ = w;
+}
+
+inline bool BellDiagonalState::apply_gate(const Gate& gate) {
+    switch (gate.kind()) {
+    case Gate::IDENTITY:
+    case Gate::SWAP: return true;
+    case Gate::X: apply_pauli(true, false); return true;
+    case Gate::Y: apply_pauli(true, true); return true;
+    case Gate::Z: apply_pauli(false, true); return true;
+    default: return false;
+    }
+}
+
+inline void BellDiagonalState::apply_pauli_channel(const PauliProbabilities& probabilities) {
+    std::array<double, 4> w{};
+    for (int k = 0; k < 4; ++k)
+        for (int j = 0; j < 4; ++j)
+            w[k ^ j] += probabilities[j] * weights_[k];
+    weights_ = w;
+}
+
+inline void BellDiagonalState::depolarize(double p) {
+    apply_pauli_channel({1 - p, p / 3, p / 3, p / 3});
+}
+
+inline void BellDiagonalState::dephase(double p) {
+    apply_pauli_channel({1 - p, p, 0, 0});
+}
+
+inline void BellDiagonalState::twirl() {
+    *this = werner(weights_[PHI_PLUS]);
+}
+
+inline qpp::ket BellDiagonalState::bell_ket(Bell bell) {
+    // (I ⊗ X^x Z^z)|Φ+⟩, qubit 0 the most significant
+    const double s = 1 / std::sqrt(2.0);
+    qpp::ket b = qpp::ket::Zero(4);
+    switch (bell) {
+    case PHI_PLUS: b << s, 0, 0, s; break;
+    case PHI_MINUS: b << s, 0, 0, -s; break;
+    case PSI_PLUS: b << 0, s, s, 0; break;
+    case PSI_MINUS: b << 0, s, -s, 0; break;
+    }
+    return b;
+}
+
+inline qpp::cmat BellDiagonalState::to_density_matrix() const {
+    qpp::cmat rho = qpp::cmat::Zero(4, 4);
+    for (int k = 0; k < 4; ++k)
+        if (weights_[k] != 0)
+            rho += weights_[k] * qpp::prj(bell_ket(static_cast<Bell>(k)));
+    return rho;
+}
@@ -0,0 +1,196 @@
+#include "2_branching_runner.h"
+#include "ns3/abort.h"
+#include "ns3/object.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// Set in the processes of a branching run only
+struct BranchContext {
+    int fd = -1; // where leaves report
+    double weight = 1;
+    double min_probability = 0;
+    bool failed = false;
+};
+BranchContext* g_branch = nullptr;
+
+// Buffered output would be written again by every child that inherits it,
+// and whatever a child buffers itself is lost at _exit
+void flush_output() {
+    std::cout.flush();
+    std::fflush(nullptr);
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool read_all(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// A leaf on the wire: its weight, the number of metrics, then per metric
+// the name length, the name and the value
+bool write_leaf(int fd, double weight, const BranchingRunner::Metrics& metrics) {
+    const uint64_t size = metrics.size();
+    if (!write_all(fd, &weight, sizeof(weight)) || !write_all(fd, &size, sizeof(size)))
+        return false;
+    for (const auto& [name, value] : metrics) {
+        const uint64_t length = name.size();
+        if (!write_all(fd, &length, sizeof(length)) || !write_all(fd, name.data(), length) ||
+            !write_all(fd, &value, sizeof(value)))
+            return false;
+    }
+    return true;
+}
+
+bool read_leaf(int fd, double& weight, BranchingRunner::Metrics& metrics) {
+    uint64_t size;
+    if (!read_all(fd, &weight, sizeof(weight)) || !read_all(fd, &size, sizeof(size)))
+        return false;
+    metrics.clear();
+    for (uint64_t i = 0; i < size; ++i) {
+        uint64_t length;
+        double value;
+        std::string name;
+        if (!read_all(fd, &length, sizeof(length)))
+            return false;
+        name.resize(length);
+        if (!read_all(fd, name.data(), length) || !read_all(fd, &value, sizeof(value)))
+            return false;
+        metrics[name] = value;
+    }
+    return true;
+}
+
+// Weighted running moments and range of one metric
+struct Accumulator {
+    double weight = 0;
+    double sum = 0;
+    double sum_sq = 0;
+    double min = 0;
+    double max = 0;
+    size_t branches = 0;
+
+    void add(double w, double x) {
+        min = branches ? std::min(min, x) : x;
+        max = branches ? std::max(max, x) : x;
+        ++branches;
+        weight += w;
+        sum += w * x;
+        sum_sq += w * x * x;
+    }
+};
+
+} // namespace
+
+BranchingRunner::BranchingRunner(double min_probability) : min_probability_(min_probability) {}
+
+bool BranchingRunner::active() {
+    return g_branch != nullptr;
+}
+
+double BranchingRunner::weight() {
+    return g_branch ? g_branch->weight : 1.0;
+}
+
+size_t BranchingRunner::branch(const std::vector<double>& probabilities) {
+    NS_ABORT_MSG_IF(!g_branch, "BranchingRunner::branch called outside a branching run");
+    std::vector<size_t> outcomes;
+    for (size_t o = 0; o < probabilities.size(); ++o)
+        if (probabilities[o] >= g_branch->min_probability)
+            outcomes.push_back(o);
+    NS_ABORT_MSG_IF(outcomes.empty(), "no outcome is possible");
+
+    // Every outcome but the last runs to completion in a child of its own
+    // before the next starts; this process then follows the last one
+    for (size_t i = 0; i + 1 < outcomes.size(); ++i) {
+        flush_output();
+        pid_t pid = ::fork();
+        NS_ABORT_MSG_IF(pid < 0, "fork failed");
+        if (pid == 0) {
+            g_branch->weight *= probabilities[outcomes[i]];
+            return outcomes[i];
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            g_branch->failed = true;
+    }
+    g_branch->weight *= probabilities[outcomes.back()];
+    return outcomes.back();
+}
+
+BranchingRunner::Summary BranchingRunner::run(const Scenario& scenario) const {
+    int fd[2];
+    NS_ABORT_MSG_IF(::pipe(fd) != 0, "pipe failed");
+    flush_output();
+    pid_t trunk = ::fork();
+    NS_ABORT_MSG_IF(trunk < 0, "fork failed");
+    if (trunk == 0) {
+        // Every process from here on is a branch: it runs the rest of the
+        // scenario, reports its leaf and exits, failing if any of the
+        // branches it forked did
+        ::close(fd[0]);
+        static BranchContext context;
+        context.fd = fd[1];
+        context.min_probability = min_probability_;
+        g_branch = &context;
+        Metrics metrics = scenario({0, ns3::CreateObject<ns3::QuantumStateRegistry>()});
+        ns3::Simulator::Destroy();
+        const bool ok = write_leaf(context.fd, context.weight, metrics) && !context.failed;
+        flush_output();
+        ::_exit(ok ? 0 : 1);
+    }
+    ::close(fd[1]);
+
+    std::map<std::string, Accumulator> acc;
+    double weight;
+    Metrics metrics;
+    double total = 0;
+    while (read_leaf(fd[0], weight, metrics)) {
+        total += weight;
+        for (const auto& [name, value] : metrics)
+            acc[name].add(weight, value);
+    }
+    ::close(fd[0]);
+    int status = 0;
+    ::waitpid(trunk, &status, 0);
+    NS_ABORT_MSG_IF(!WIFEXITED(status) || WEXITSTATUS(status) != 0, "a branch failed");
+
+    // Leaves whose weight was dropped below the threshold are missing, so
+    // normalize by what was explored
+    Summary summary;
+    for (const auto& [name, a] : acc) {
+        Statistic& s = summary[name];
+        s.probability = a.weight / total;
+        s.mean = a.sum / a.weight;
+        s.std_dev = std::sqrt(std::max(0.0, a.sum_sq / a.weight - s.mean * s.mean));
+        s.min = a.min;
+        s.max = a.max;
+        s.branches = a.branches;
+    }
+    return summary;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "2_replica_runner.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Exact counterpart of ReplicaRunner for protocols whose randomness is
+// measurement outcomes and qubit loss. Instead of sampling, every
+// measurement (and every lossy transmission) forks the running simulation,
+// one branch per outcome with nonzero probability, each weighted by the
+// probability of its path. The forks are processes, so branches share all
+// simulation state copy-on-write and the ns-3 simulator simply carries on
+// in each of them. Branches run depth-first, one at a time, so at most one
+// process per branch point is alive. Metrics are then exact
+// probability-weighted averages over all leaves. The number of leaves is
+// exponential in the number of branch points, so this suits small
+// protocols such as teleportation and swapping; other randomness (e.g.
+// trajectory-mode noise) is still sampled.
+class BranchingRunner {
+public:
+    using Metrics = ReplicaRunner::Metrics;
+    using Scenario = ReplicaRunner::Scenario;
+
+    struct Statistic {
+        double probability = 0; // of the branches that reported the metric
+        double mean = 0;        // conditional on being reported
+        double std_dev = 0;
+        double min = 0;
+        double max = 0;
+        size_t branches = 0;
+    };
+    using Summary = std::map<std::string, Statistic>;
+
+    // Branches below min_probability are dropped rather than explored
+    explicit BranchingRunner(double min_probability = 1e-12);
+
+    Summary run(const Scenario& scenario) const;
+
+    // Whether the calling code is running inside a branching run
+    static bool active();
+    // Called where an outcome would be sampled: explores every outcome whose
+    // probability is at least the threshold and returns the one this branch
+    // follows
+    static size_t branch(const std::vector<double>& probabilities);
+    // Probability of the path the calling branch has taken so far
+    static double weight();
+
+private:
+    double min_probability_;
+};
@@ -0,0 +1,29 @@
+#include "2_counter_rng.h"
+#include "ns3/rng-seed-manager.h"
+#include <atomic>
+
+// Known-answer tests from Random123 (kat_vectors, philox4x32_10)
+static_assert(CounterRng::block(0, 0, 0) ==
+              std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+static_assert(CounterRng::block(0xffffffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff) ==
+              std::array<uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+static_assert(CounterRng::block(0x299f31d0a4093822, 0x0370734413198a2e, 0x85a308d3243f6a88) ==
+              std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+
+CounterRng CounterRng::from_seed_manager(uint64_t stream) {
+    const uint64_t seed = ns3::RngSeedManager::GetSeed();
+    const uint64_t run = ns3::RngSeedManager::GetRun();
+    return CounterRng(mix(mix(seed) ^ run), stream);
+}
+
+CounterRng CounterRng::automatic() {
+    return from_seed_manager((uint64_t{1} << 63) | ns3::RngSeedManager::GetNextStreamIndex());
+}
+
+// Counted down from the top of the index space so they never take an
+// automatic or assigned stream number
+CounterRng& CounterRng::thread_default() {
+    static std::atomic<uint64_t> threads{0};
+    thread_local CounterRng rng = from_seed_manager(~threads++);
+    return rng;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <limits>
+
+// Counter-based generator (Philox4x32-10, Salmon et al., SC'11). Output
+// block n of a stream is a pure function of (key, stream, n), so a stream
+// is just three integers: any number of them can be created or split off
+// without touching shared state, and two streams never overlap.
+//
+// Streams follow ns-3's numbering: the key is derived from RngSeedManager's
+// seed and run, and objects take an automatic stream index unless
+// AssignStreams() fixes one. Changing the run therefore changes every
+// stream, as it does for ns-3's own random variables.
+class CounterRng {
+public:
+    using result_type = uint32_t;
+
+    CounterRng(uint64_t key = 0, uint64_t stream = 0) : key_(key), stream_(stream) {}
+
+    // Stream index stream under RngSeedManager's current seed and run
+    static CounterRng from_seed_manager(uint64_t stream);
+    // The next automatically numbered stream. Like ns-3's random variables,
+    // these sit in the upper half of the index space, apart from the ones
+    // AssignStreams() hands out.
+    static CounterRng automatic();
+    // Per-thread stream for samples no object owns, e.g. a QuantumState used
+    // on its own. Keyed by the seed and run current when the thread first
+    // uses it.
+    static CounterRng& thread_default();
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+    result_type operator()();
+
+    // Uniform in [0, 1), 53 random bits
+    double uniform();
+
+    // Independent child stream number id
+    CounterRng split(uint64_t id) const;
+
+    uint64_t key() const { return key_; }
+    uint64_t stream() const { return stream_; }
+
+    // The raw Philox4x32-10 block: counter and stream are the low and high
+    // halves of the 128-bit counter, key the two key words
+    static constexpr std::array<uint32_t, 4> block(uint64_t key, uint64_t stream, uint64_t counter);
+
+private:
+    static uint64_t mix(uint64_t x);
+
+    uint64_t key_;
+    uint64_t stream_;
+    uint64_t counter_ = 0;
+    std::array<uint32_t, 4> buffer_{};
+    unsigned used_ = 4; // words of buffer_ already returned
+};
+
+
+// ----------- Inline implementations ------------
+inline CounterRng::result_type CounterRng::operator()() {
+    if (used_ == 4) {
+        buffer_ = block(key_, stream_, counter_++);
+        used_ = 0;
+    }
+    return buffer_[used_++];
+}
+
+inline double CounterRng::uniform() {
+    const uint64_t a = (*this)() >> 5, b = (*this)() >> 6;
+    return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+}
+
+inline CounterRng CounterRng::split(uint64_t id) const {
+    return CounterRng(key_, mix(stream_ ^ mix(id + 0x9E3779B97F4A7C15ull)));
+}
+
+// splitmix64 finalizer
+inline uint64_t CounterRng::mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+constexpr std::array<uint32_t, 4> CounterRng::block(uint64_t key, uint64_t stream, uint64_t counter) {
+    std::array<uint32_t, 4> c = {uint32_t(counter), uint32_t(counter >> 32), uint32_t(stream), uint32_t(stream >> 32)};
+    uint32_t k0 = uint32_t(key), k1 = uint32_t(key >> 32);
+    for (int round = 0; round < 10; ++round) {
+        const uint64_t p0 = uint64_t{0xD2511F53} * c[0];
+        const uint64_t p1 = uint64_t{0xCD9E8D57} * c[2];
+        c = {uint32_t(p1 >> 32) ^ c[1] ^ k0, uint32_t(p1), uint32_t(p0 >> 32) ^ c[3] ^ k1, uint32_t(p0)};
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+    return c;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "qpp/qpp.hpp"
+#include "2_gate.h"
+#include "2_state_vector_kernels.h"
+#include <vector>
+
+// Kernels on an n-qubit density matrix stored column-major as a vector of
+// 4^n amplitudes, i.e. vec(ρ). Read as a 2n-qubit ket, qubits 0..n-1 are
+// the column index and n..2n-1 the row index, so vec(K ρ K†) is K on the
+// row qubits and K* on the column qubits, and a superoperator
+// S = Σ K* ⊗ K acts on {columns of targets, rows of targets}. Everything
+// then reuses the state-vector kernels.
+namespace kernels {
+
+// The 2n-qubit targets a superoperator on targets acts on
+inline std::vector<idx> superoperator_targets(const std::vector<idx>& targets, idx n) {
+    std::vector<idx> result(targets);
+    for (idx t : targets)
+        result.push_back(n + t);
+    return result;
+}
+
+// ρ → U ρ U†. Named gates go through the permutation/phase kernels on both
+// sides; those kernels use the canonical matrices, so the column side uses
+// the exact conjugate of the canonical matrix (Y* = -Y is the one kind whose
+// conjugate differs from a named gate by a phase). H has no dedicated
+// kernel and its matrix may carry a phase (e.g. after fusion), so it is
+// conjugated like a generic gate.
+inline void apply_density(qpp::ket& rho, const Gate& gate, const std::vector<idx>& targets, idx n) {
+    std::vector<idx> rows;
+    for (idx t : targets)
+        rows.push_back(n + t);
+    apply(rho, gate, rows, 2 * n);
+
+    if (gate.kind() == Gate::GENERIC || gate.kind() == Gate::H) {
+        apply_matrix(rho, gate.matrix().conjugate(), targets, 2 * n);
+        return;
+    }
+    switch (gate.kind()) {
+    case Gate::S: return apply_s(rho, 2 * n, targets[0], true);
+    case Gate::SDG: return apply_s(rho, 2 * n, targets[0], false);
+    case Gate::T: return apply_phase(rho, 2 * n, targets[0], std::polar(1.0, -qpp::pi / 4));
+    case Gate::TDG: return apply_phase(rho, 2 * n, targets[0], std::polar(1.0, qpp::pi / 4));
+    case Gate::Y:
+        apply_y(rho, 2 * n, targets[0]);
+        rho = -rho;
+        return;
+    default:
+        return apply(rho, gate, targets, 2 * n); // real matrices
+    }
+}
+
+inline void apply_superoperator(qpp::ket& rho, const qpp::cmat& S, const std::vector<idx>& targets, idx n) {
+    apply_matrix(rho, S, superoperator_targets(targets, n), 2 * n);
+}
+
+// Probabilities of the 2^k joint Z-basis outcomes of targets, from the
+// diagonal; outcomes have targets[0] as their most significant bit
+inline std::vector<double> outcome_probabilities_density(const qpp::ket& rho, idx n, const std::vector<idx>& targets) {
+    const idx k = targets.size();
+    const idx D = idx{1} << n;
+    const qpp::cplx* data = rho.data();
+    std::vector<double> probs(idx{1} << k, 0.0);
+    for (idx i = 0; i < D; ++i) {
+        idx o = 0;
+        for (idx j = 0; j < k; ++j)
+            o = (o << 1) | ((i >> (n - 1 - targets[j])) & 1);
+        probs[o] += data[i * D + i].real();
+    }
+    return probs;
+}
+
+// Keeps the block where both the row and column bits of targets match
+// result, whose probability is p: it is compacted to the front,
+// renormalized, and the buffer shrinks to n-k qubits
+inline void collapse_density(qpp::ket& rho, idx n, const std::vector<idx>& targets, idx result, double p) {
+    const idx k = targets.size();
+    const idx D = idx{1} << n;
+    idx all = 0, pattern = 0;
+    for (idx j = 0; j < k; ++j) {
+        const idx mask = idx{1} << (n - 1 - targets[j]);
+        all |= mask;
+        if ((result >> (k - 1 - j)) & 1)
+            pattern |= mask;
+    }
+
+    qpp::cplx* data = rho.data();
+    const double scale = 1.0 / p;
+    idx dst = 0;
+    for (idx c = 0; c < D; ++c) {
+        if ((c & all) != pattern)
+            continue;
+        for (idx r = 0; r < D; ++r)
+            if ((r & all) == pattern)
+                data[dst++] = data[c * D + r] * scale;
+    }
+    rho.conservativeResize(dst);
+}
+
+// Joint Z-basis measurement of targets with uniform sample u in [0, 1)
+inline idx measure_density(qpp::ket& rho, idx n, const std::vector<idx>& targets, double u) {
+    const std::vector<double> probs = outcome_probabilities_density(rho, n, targets);
+    idx result = 0;
+    double acc = 0;
+    for (idx o = 0; o < probs.size(); ++o) {
+        if (probs[o] <= 0)
+            continue;
+        acc += probs[o];
+        result = o;
+        if (u < acc)
+            break;
+    }
+    collapse_density(rho, n, targets, result, probs[result]);
+    return result;
+}
+
+// Partial trace over target, in place
+inline void trace_out_density(qpp::ket& rho, idx n, idx target) {
+    const idx D = idx{1} << n;
+    const idx pos = n - 1 - target;
+    const idx bit = idx{1} << pos;
+    qpp::cplx* data = rho.data();
+
+    // Entry (r, c) of the result only reads entries at or after its own
+    // position, so compacting front to back never overwrites a later source
+    idx dst = 0;
+    for (idx c = 0; c < D / 2; ++c) {
+        const idx c0 = insert_zero_bit(c, pos);
+        for (idx r = 0; r < D / 2; ++r) {
+            const idx r0 = insert_zero_bit(r, pos);
+            data[dst++] = data[c0 * D + r0] + data[(c0 | bit) * D + (r0 | bit)];
+        }
+    }
+    rho.conservativeResize(dst);
+}
+
+} // namespace kernels
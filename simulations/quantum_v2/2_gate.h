@@ -0,0 +1,73 @@
+#pragma once
+#include "qpp/qpp.hpp"
+#include <cmath>
+#include <vector>
+
+// A gate matrix tagged with what kind of gate it is. Named kinds let the
+// state backends use permutation/phase-only kernels (or tableau updates)
+// instead of a dense matrix product. A plain qpp::cmat converts implicitly
+// and is recognized when it matches a named gate up to a global phase, so
+// existing calls such as ApplyGate(qpp::gt.X, q) take the fast path too.
+class Gate {
+public:
+    enum Kind { GENERIC, IDENTITY, X, Y, Z, H, S, SDG, T, TDG, CNOT, CZ, SWAP };
+
+    Gate(const qpp::cmat& U);
+    Gate(Kind kind);
+
+    Kind kind() const { return kind_; }
+    const qpp::cmat& matrix() const { return matrix_; }
+    size_t num_qubits() const { return static_cast<size_t>(std::log2(matrix_.rows())); }
+
+    bool is_clifford() const;
+
+private:
+    static const qpp::cmat& matrix_for(Kind kind);
+    static Kind classify(const qpp::cmat& U);
+    static bool equal_up_to_phase(const qpp::cmat& A, const qpp::cmat& B);
+
+    Kind kind_;
+    qpp::cmat matrix_;
+};
+
+
+// ----------- Inline implementations ------------
+inline Gate::Gate(const qpp::cmat& U) : kind_(classify(U)), matrix_(U) {}
+
+inline Gate::Gate(Kind kind) : kind_(kind), matrix_(matrix_for(kind)) {}
+
+inline bool Gate::is_clifford() const {
+    return kind_ != GENERIC && kind_ != T && kind_ != TDG;
+}
+
+inline const qpp::cmat& Gate::matrix_for(Kind kind) {
+    // Indexed by Kind; GENERIC has no fixed matrix
+    static const std::vector<qpp::cmat> matrices = {
+        qpp::gt.Id2, qpp::gt.Id2, qpp::gt.X, qpp::gt.Y, qpp::gt.Z, qpp::gt.H,
+        qpp::gt.S, qpp::adjoint(qpp::gt.S), qpp::gt.T, qpp::adjoint(qpp::gt.T),
+        qpp::gt.CNOT, qpp::gt.CZ, qpp::gt.SWAP};
+    return matrices[kind];
+}
+
+inline Gate::Kind Gate::classify(const qpp::cmat& U) {
+    static const Kind one_qubit[] = {IDENTITY, X, Y, Z, H, S, SDG, T, TDG};
+    static const Kind two_qubit[] = {CNOT, CZ, SWAP};
+    if (U.rows() == 2 && U.cols() == 2) {
+        for (Kind k : one_qubit)
+            if (equal_up_to_phase(U, matrix_for(k))) return k;
+    } else if (U.rows() == 4 && U.cols() == 4) {
+        for (Kind k : two_qubit)
+            if (equal_up_to_phase(U, matrix_for(k))) return k;
+    }
+    return GENERIC;
+}
+
+inline bool Gate::equal_up_to_phase(const qpp::cmat& A, const qpp::cmat& B) {
+    Eigen::Index r, c;
+    B.cwiseAbs().maxCoeff(&r, &c);
+    if (std::abs(A(r, c)) < 1e-12)
+        return false;
+    // A scaled matrix is not the gate: 0.5 * X must not pass as X
+    qpp::cplx phase = A(r, c) / B(r, c);
+    return std::abs(std::abs(phase) - 1) < 1e-9 && (A - phase * B).norm() < 1e-9;
+}
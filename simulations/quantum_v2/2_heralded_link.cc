@@ -0,0 +1,115 @@
+#include "2_heralded_link.h"
+#include "2_branching_runner.h"
+#include "2_quantum_component.h"
+#include "ns3/abort.h"
+#include "ns3/double.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+
+#include <cmath>
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED(HeraldedLink);
+
+TypeId HeraldedLink::GetTypeId() {
+    static TypeId tid = TypeId("ns3::HeraldedLink")
+        .SetParent<Object>()
+        .SetGroupName("Quantum")
+        .AddConstructor<HeraldedLink>()
+        .AddAttribute("AttemptRate",
+                      "Entanglement generation attempts per second",
+                      DoubleValue(1e6),
+                      MakeDoubleAccessor(&HeraldedLink::m_attemptRate),
+                      MakeDoubleChecker<double>(0.0))
+        .AddAttribute("Channel",
+                      "Channel the attempts are made over",
+                      PointerValue(),
+                      MakePointerAccessor(&HeraldedLink::m_channel),
+                      MakePointerChecker<QuantumChannel>());
+    return tid;
+}
+
+HeraldedLink::HeraldedLink()
+    : m_attemptRate(1e6), m_rng(CounterRng::automatic()), m_attempts(0), m_successes(0) {}
+
+void HeraldedLink::Attach(Ptr<QuantumChannel> channel) {
+    m_channel = channel;
+}
+
+Ptr<QuantumChannel> HeraldedLink::GetChannel() const {
+    return m_channel;
+}
+
+void HeraldedLink::SetAttemptRate(double rate) {
+    m_attemptRate = rate;
+}
+
+double HeraldedLink::GetAttemptRate() const {
+    return m_attemptRate;
+}
+
+void HeraldedLink::SetHeraldCallback(HeraldCallback cb) {
+    m_herald = std::move(cb);
+}
+
+int64_t HeraldedLink::AssignStreams(int64_t stream) {
+    m_rng = CounterRng::from_seed_manager(stream);
+    return 1;
+}
+
+void HeraldedLink::Generate() {
+    NS_ABORT_MSG_IF(!m_channel, "HeraldedLink has no channel");
+    NS_ABORT_MSG_IF(BranchingRunner::active(), "heralded generation cannot be branched over");
+    NS_ABORT_MSG_IF(m_attemptRate <= 0, "AttemptRate must be positive");
+    if (IsGenerating())
+        return;
+
+    // The successful attempt is made after `failures` periods and heard
+    // from one channel delay later; converting the whole wait at once keeps
+    // the rounding of one period from adding up
+    const uint64_t failures = SampleFailures();
+    m_event = Simulator::Schedule(Seconds(static_cast<double>(failures) / m_attemptRate) + m_channel->GetDelay(),
+                                  &HeraldedLink::Herald, this, failures + 1);
+}
+
+void HeraldedLink::Cancel() {
+    m_event.Cancel();
+    m_event = EventId();
+}
+
+bool HeraldedLink::IsGenerating() const {
+    return m_event.IsPending();
+}
+
+uint64_t HeraldedLink::GetAttempts() const {
+    return m_attempts;
+}
+
+uint64_t HeraldedLink::GetSuccesses() const {
+    return m_successes;
+}
+
+// Inversion sampling: P(failures >= k) = loss^k
+uint64_t HeraldedLink::SampleFailures() {
+    const double loss = m_channel->GetLossProbability();
+    NS_ABORT_MSG_IF(loss >= 1, "a channel that loses every qubit never heralds");
+    if (loss <= 0)
+        return 0;
+    return static_cast<uint64_t>(std::floor(std::log1p(-m_rng.uniform()) / std::log(loss)));
+}
+
+void HeraldedLink::Herald(uint64_t attempts) {
+    m_event = EventId();
+    m_attempts += attempts;
+    ++m_successes;
+
+    Ptr<QuantumComponent> sender = m_channel->GetSender();
+    auto [kept, sent] = sender->CreateEntangledPair();
+    sender->RemoveQubit(sent);
+    m_channel->Deliver(sent);
+    if (m_herald)
+        m_herald(kept, sent, attempts);
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "ns3/object.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "2_counter_rng.h"
+#include "2_qubit.h"
+#include "2_quantum_channel.h"
+
+#include <functional>
+#include <memory>
+
+namespace ns3 {
+
+// Heralded entanglement generation over a QuantumChannel. The channel's
+// sender makes one attempt every 1/AttemptRate seconds: it creates a pair and
+// sends half, which is lost with the channel's LossProbability. The number
+// of failed attempts before the first success is geometric, so it is drawn
+// once and a single event is scheduled for when the successful half
+// arrives, one channel delay after its attempt. That is the herald: the
+// pair is created then, and the half is delivered with the channel's
+// ErrorModel applied. Arrival times and attempt counts have exactly the
+// distribution of attempting one by one, at one event per success instead
+// of one per attempt.
+//
+// Exact branching cannot enumerate the unbounded number of failures, so
+// Generate() is not available under BranchingRunner.
+class HeraldedLink : public Object {
+public:
+    static TypeId GetTypeId();
+
+    // Called when a half arrives, with the half kept by the sender, the one
+    // stored at the receiver and the number of attempts it took
+    using HeraldCallback = std::function<void(std::shared_ptr<Qubit>, std::shared_ptr<Qubit>, uint64_t)>;
+
+    HeraldedLink();
+
+    void Attach(Ptr<QuantumChannel> channel);
+    Ptr<QuantumChannel> GetChannel() const;
+
+    void SetAttemptRate(double rate);
+    double GetAttemptRate() const;
+
+    void SetHeraldCallback(HeraldCallback cb);
+
+    // Fixes the stream the attempt counts are drawn from; returns the
+    // number of streams used (1)
+    int64_t AssignStreams(int64_t stream);
+
+    // Starts attempting now, until one attempt succeeds
+    void Generate();
+    // Stops a generation in progress
+    void Cancel();
+    bool IsGenerating() const;
+
+    // Totals over all successful generations
+    uint64_t GetAttempts() const;
+    uint64_t GetSuccesses() const;
+
+private:
+    // Failed attempts before the first success
+    uint64_t SampleFailures();
+    void Herald(uint64_t attempts);
+
+    Ptr<QuantumChannel> m_channel;
+    double m_attemptRate;
+    HeraldCallback m_herald;
+    CounterRng m_rng;
+    EventId m_event;
+    uint64_t m_attempts;
+    uint64_t m_successes;
+};
+
+}
@@ -1,8 +1,12 @@
 #include "2_quantum_channel.h"
+#include "2_branching_runner.h"
 
 #include "ns3/log.h"
+#include "ns3/abort.h"
 #include "ns3/simulator.h"
 #include "ns3/net-device.h"
+#include "ns3/double.h"
+#include "ns3/pointer.h"
 
 #include <iostream>
 
@@ -14,12 +18,23 @@ TypeId QuantumChannel::GetTypeId() {
     static TypeId tid = TypeId("ns3::QuantumChannel")
         .SetParent<Channel>()
         .SetGroupName("Quantum")
-        .AddConstructor<QuantumChannel>();
+        .AddConstructor<QuantumChannel>()
+        .AddAttribute("LossProbability",
+                      "Probability that a qubit is lost in transit",
+                      DoubleValue(0.0),
+                      MakeDoubleAccessor(&QuantumChannel::m_lossProb),
+                      MakeDoubleChecker<double>(0.0, 1.0))
+        .AddAttribute("ErrorModel",
+                      "Noise applied to qubits that arrive",
+                      PointerValue(),
+                      MakePointerAccessor(&QuantumChannel::m_errorModel),
+                      MakePointerChecker<QuantumErrorModel>());
     return tid;
 }
 
 QuantumChannel::QuantumChannel()
-    : m_delay(NanoSeconds(0)), m_lossProb(0.0) {}
+    : m_delay(NanoSeconds(0)), m_lossProb(0.0),
+      m_random(CreateObject<UniformRandomVariable>()) {}
 
 void QuantumChannel::SetDelay(Time delay) {
     m_delay = delay;
@@ -33,19 +48,95 @@ void QuantumChannel::SetLossProbability(double loss) {
     m_lossProb = loss;
 }
 
+double QuantumChannel::GetLossProbability() const {
+    return m_lossProb;
+}
+
+void QuantumChannel::SetErrorModel(Ptr<QuantumErrorModel> model) {
+    m_errorModel = model;
+}
+
+int64_t QuantumChannel::AssignStreams(int64_t stream) {
+    m_random->SetStream(stream);
+    int64_t used = 1;
+    if (m_errorModel)
+        used += m_errorModel->AssignStreams(stream + used);
+    return used;
+}
+
 void QuantumChannel::Connect(Ptr<QuantumComponent> sender, Ptr<QuantumComponent> receiver) {
     m_sender = sender;
     m_receiver = receiver;
 }
 
+Ptr<QuantumComponent> QuantumChannel::GetSender() const {
+    return m_sender;
+}
+
+Ptr<QuantumComponent> QuantumChannel::GetReceiver() const {
+    return m_receiver;
+}
+
 void QuantumChannel::Transmit(std::shared_ptr<Qubit> q) {
     Simulator::Schedule(m_delay, [this, q]() {
+        // A lost qubit is simply never delivered; once its last handle is
+        // dropped the registry discards it from any state it shared
+        if (Lost()) {
+            std::cout << "[QuantumChannel] t = "
+                      << Simulator::Now().GetMicroSeconds() << "µs: Qubit lost\n";
+            return;
+        }
         std::cout << "[QuantumChannel] t = "
                   << Simulator::Now().GetMicroSeconds() << "µs: Transmitting Qubit\n";
-        this->m_receiver->StoreQubit(q);
+        Deliver(q);
     });
 }
 
+void QuantumChannel::TransmitTrain(QubitTrain train) {
+    NS_ABORT_MSG_IF(train.offsets.size() != train.qubits.size(), "a train needs one offset per qubit");
+    if (train.qubits.empty())
+        return;
+    const Time arrival = m_delay + train.offsets.back();
+    Simulator::Schedule(arrival, [this, train = std::move(train)]() mutable { DeliverTrain(train); });
+}
+
+bool QuantumChannel::Lost() {
+    return BranchingRunner::active() ? BranchingRunner::branch({1.0 - m_lossProb, m_lossProb}) == 1
+                                     : m_random->GetValue() < m_lossProb;
+}
+
+// Lost qubits are compacted out of the train in place, and the offsets
+// rebased onto the delivery time
+void QuantumChannel::DeliverTrain(QubitTrain& train) {
+    const size_t sent = train.qubits.size();
+    const Time last = train.offsets.back();
+    size_t kept = 0;
+    for (size_t i = 0; i < sent; ++i) {
+        if (Lost())
+            continue;
+        train.qubits[kept] = std::move(train.qubits[i]);
+        train.offsets[kept] = train.offsets[i] - last;
+        ++kept;
+    }
+    train.qubits.resize(kept);
+    train.offsets.resize(kept);
+
+    std::cout << "[QuantumChannel] t = " << Simulator::Now().GetMicroSeconds()
+              << "µs: Transmitting train of " << kept << " qubits (" << sent - kept << " lost)\n";
+    if (kept == 0)
+        return;
+    if (m_errorModel)
+        for (const auto& q : train.qubits)
+            m_errorModel->Apply(q);
+    m_receiver->StoreQubits(train);
+}
+
+void QuantumChannel::Deliver(std::shared_ptr<Qubit> q) {
+    if (m_errorModel)
+        m_errorModel->Apply(q);
+    m_receiver->StoreQubit(q);
+}
+
 std::size_t QuantumChannel::GetNDevices() const {
     return 0; // not using NetDevices yet
 }
@@ -1,8 +1,10 @@
 #pragma once
 #include "ns3/channel.h"
 #include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
 #include "2_qubit.h"
 #include "2_quantum_component.h"
+#include "2_quantum_error_model.h"
 
 namespace ns3 {
 
@@ -16,17 +18,41 @@ public:
     Time GetDelay() const;
 
     void SetLossProbability(double loss);
+    double GetLossProbability() const;
+    // Noise applied to every qubit that makes it across
+    void SetErrorModel(Ptr<QuantumErrorModel> model);
+
+    // Fixes the loss stream, then the error model's; returns the number of
+    // streams used
+    int64_t AssignStreams(int64_t stream);
 
     std::size_t GetNDevices() const override;
     Ptr<NetDevice> GetDevice(std::size_t i) const override;
 
 
     void Connect(Ptr<QuantumComponent> sender, Ptr<QuantumComponent> receiver);
+    Ptr<QuantumComponent> GetSender() const;
+    Ptr<QuantumComponent> GetReceiver() const;
+
+    // q arrives after the delay unless it is lost on the way
     void Transmit(std::shared_ptr<Qubit> q);
+    // The train arrives as one event once its last qubit is in, i.e. after
+    // the delay plus the last offset. Each qubit is lost or takes noise on
+    // its own, and the receiver stores what is left in one StoreQubits call.
+    // Delivered offsets are arrival times relative to that event (<= 0).
+    void TransmitTrain(QubitTrain train);
+    // q arrives now: the error model is applied and the receiver stores it
+    void Deliver(std::shared_ptr<Qubit> q);
 
 private:
+    // Samples whether one qubit is lost in transit
+    bool Lost();
+    void DeliverTrain(QubitTrain& train);
+
     Time m_delay;
     double m_lossProb;
+    Ptr<QuantumErrorModel> m_errorModel;
+    Ptr<UniformRandomVariable> m_random;
 
     Ptr<QuantumComponent> m_sender;
     Ptr<QuantumComponent> m_receiver;
@@ -1,7 +1,11 @@
 #include "2_quantum_component.h"
+#include "2_branching_runner.h"
+#include "ns3/abort.h"
 #include "ns3/log.h"
 #include "ns3/node.h"
-#include <unordered_set>
+#include "ns3/enum.h"
+#include "ns3/boolean.h"
+#include "ns3/pointer.h"
 #include <algorithm>
 
 namespace ns3 {
@@ -12,37 +16,86 @@ TypeId QuantumComponent::GetTypeId() {
     static TypeId tid = TypeId("ns3::QuantumComponent")
         .SetParent<Object>()
         .SetGroupName("Quantum")
-        .AddConstructor<QuantumComponent>();
+        .AddConstructor<QuantumComponent>()
+        .AddAttribute("Backend",
+                      "Representation used for quantum states created by this component",
+                      EnumValue(QuantumState::KET),
+                      MakeEnumAccessor<QuantumState::Backend>(&QuantumComponent::m_backend),
+                      MakeEnumChecker(QuantumState::KET, "Ket",
+                                      QuantumState::STABILIZER, "Stabilizer",
+                                      QuantumState::DENSITY, "Density",
+                                      QuantumState::BELL_DIAGONAL, "BellDiagonal"))
+        .AddAttribute("AutoFactorize",
+                      "Split measured states into independent product factors. Each check "
+                      "costs several passes over the state, so it is off by default; "
+                      "call Factorize() where a product state is expected instead",
+                      BooleanValue(false),
+                      MakeBooleanAccessor(&QuantumComponent::m_autoFactorize),
+                      MakeBooleanChecker())
+        .AddAttribute("Registry",
+                      "Registry tracking the states of qubits created here; components "
+                      "that exchange qubits in one simulation should share one",
+                      PointerValue(),
+                      MakePointerAccessor(&QuantumComponent::SetRegistry, &QuantumComponent::GetRegistry),
+                      MakePointerChecker<QuantumStateRegistry>())
+        .AddAttribute("GateErrorModel",
+                      "Noise applied to the qubits of every gate",
+                      PointerValue(),
+                      MakePointerAccessor(&QuantumComponent::m_gateErrorModel),
+                      MakePointerChecker<QuantumErrorModel>());
     return tid;
 }
 
-QuantumComponent::QuantumComponent() = default;
+QuantumComponent::QuantumComponent()
+    : m_backend(QuantumState::KET),
+      m_autoFactorize(false),
+      m_registry(CreateObject<QuantumStateRegistry>()),
+      m_ownsRegistry(true),
+      m_rng(CounterRng::automatic()) {}
+
+Ptr<QuantumStateRegistry> QuantumComponent::GetRegistry() const {
+    return m_registry;
+}
+
+void QuantumComponent::SetRegistry(Ptr<QuantumStateRegistry> registry) {
+    m_registry = registry;
+    m_ownsRegistry = false;
+}
+
+int64_t QuantumComponent::AssignStreams(int64_t stream) {
+    m_rng = CounterRng::from_seed_manager(stream);
+    int64_t used = 1;
+    if (m_ownsRegistry)
+        used += m_registry->AssignStreams(stream + used);
+    if (m_gateErrorModel)
+        used += m_gateErrorModel->AssignStreams(stream + used);
+    return used;
+}
 
 std::shared_ptr<Qubit> QuantumComponent::CreateQubit(const std::string& id) {
-    auto q = std::make_shared<Qubit>(id);
-    QuantumStateRegistry::instance().register_qubit(q);
-    qubits_.push_back(q);
+    auto q = Qubit::Create(m_registry, 0, std::make_shared<QuantumState>(1, m_backend), id);
+    qubits_.insert(q);
     return q;
 }
 
 std::shared_ptr<Qubit> QuantumComponent::GetQubitById(const std::string& id) const {
-    for (const auto& q : qubits_) {
-        if (q->get_id() == id)
-            return q;
-    }
-    return nullptr;
+    // A name nobody was given cannot match, and must not grow the table
+    const auto key = QubitId::lookup(id);
+    return key ? qubits_.find(*key) : nullptr;
 }
 
 std::pair<std::shared_ptr<Qubit>, std::shared_ptr<Qubit>> QuantumComponent::CreateEntangledPair() {
-    auto state = std::make_shared<QuantumState>(2);
-    state->apply_gate(qpp::gt.H, {0});
-    state->apply_gate(qpp::gt.CNOT, {0, 1});
-
-    auto q1 = std::make_shared<Qubit>(0, state);
-    auto q2 = std::make_shared<Qubit>(1, state);
+    std::shared_ptr<QuantumState> state;
+    if (m_backend == QuantumState::BELL_DIAGONAL) {
+        state = std::make_shared<QuantumState>(BellDiagonalState(BellDiagonalState::PHI_PLUS));
+    } else {
+        state = std::make_shared<QuantumState>(2, m_backend);
+        state->apply_gate(Gate::H, {0});
+        state->apply_gate(Gate::CNOT, {0, 1});
+    }
 
-    QuantumStateRegistry::instance().register_qubit(q1);
-    QuantumStateRegistry::instance().register_qubit(q2);
+    auto q1 = Qubit::Create(m_registry, 0, state);
+    auto q2 = Qubit::Create(m_registry, 1, state);
 
     StoreQubit(q1);
     StoreQubit(q2);
@@ -50,97 +103,229 @@ std::pair<std::shared_ptr<Qubit>, std::shared_ptr<Qubit>> QuantumComponent::Crea
 }
 
 void QuantumComponent::StoreQubit(std::shared_ptr<Qubit> q) {
-    QuantumStateRegistry::instance().register_qubit(q);
-    qubits_.push_back(q);
+    qubits_.insert(q);
     if (receive_callback_) {
         receive_callback_(q);
     }
 }
 
 
+void QuantumComponent::StoreQubits(const QubitTrain& train) {
+    for (const auto& q : train.qubits)
+        qubits_.insert(q);
+    if (train_receive_callback_) {
+        train_receive_callback_(train);
+    } else if (receive_callback_) {
+        for (const auto& q : train.qubits)
+            receive_callback_(q);
+    }
+}
+
+// The qubit stays in its entanglement group while in flight; only this
+// component's reference is dropped
 void QuantumComponent::RemoveQubit(std::shared_ptr<Qubit> q) {
-    QuantumStateRegistry::instance().unregister_qubit(q);
-    qubits_.erase(std::remove(qubits_.begin(), qubits_.end(), q), qubits_.end());
+    qubits_.erase(q);
 }
 
 
-void QuantumComponent::ApplyGate(const qpp::cmat& gate, const std::shared_ptr<Qubit>& q) {
-    q->state()->apply_gate(gate, {q->index()});
+void QuantumComponent::ApplyGate(const Gate& gate, const std::shared_ptr<Qubit>& q) {
+    if (m_gateErrorModel)
+        m_gateErrorModel->ApplyGate(*q->state(), gate, {q->index()});
+    else
+        q->state()->apply_gate(gate, {q->index()});
 }
 
-void QuantumComponent::ApplyGate(const qpp::cmat& gate, const std::vector<std::shared_ptr<Qubit>>& qs) {
+void QuantumComponent::ApplyGate(const Gate& gate, const std::vector<std::shared_ptr<Qubit>>& qs) {
     if (qs.empty()) return;
 
-    std::unordered_map<QuantumState::Ptr, std::vector<std::shared_ptr<Qubit>>> state_groups;
-    for (const auto& q : qs) {
-        state_groups[q->state()].push_back(q);
+    // Qubits from different states are first joined into one group/state
+    Ptr<QuantumStateRegistry> registry = qs[0]->registry();
+    for (size_t i = 1; i < qs.size(); ++i) {
+        if (qs[i]->registry() != registry)
+            registry->Adopt(qs[i]->registry(), qs[i]->handle());
+        registry->Merge(qs[0]->handle(), qs[i]->handle());
     }
 
-    if (state_groups.size() == 1) {
-        std::vector<qpp::idx> targets;
-        for (const auto& q : qs)
-            targets.push_back(q->index());
+    std::vector<qpp::idx> targets;
+    for (const auto& q : qs)
+        targets.push_back(q->index());
+    if (m_gateErrorModel)
+        m_gateErrorModel->ApplyGate(*qs[0]->state(), gate, targets);
+    else
         qs[0]->state()->apply_gate(gate, targets);
-        return;
-    }
+}
 
-    std::unordered_set<std::shared_ptr<Qubit>> all_qs_set;
-    for (const auto& q : qs) {
-        auto related = QuantumStateRegistry::instance().get_qubits(q->state());
-        for (const auto& qb : related)
-            all_qs_set.insert(qb);
+qpp::idx QuantumComponent::Measure(std::shared_ptr<Qubit> q) {
+    auto current_state = q->state();
+    const qpp::idx index = q->index();
+    qpp::idx result;
+    if (BranchingRunner::active()) {
+        const double p1 = current_state->probability(index);
+        result = BranchingRunner::branch({1.0 - p1, p1});
+        current_state->collapse(index, result, result ? p1 : 1.0 - p1);
+    } else {
+        result = current_state->measure(index, m_rng);
     }
 
-    std::vector<std::shared_ptr<Qubit>> all_qs(all_qs_set.begin(), all_qs_set.end());
-    std::sort(all_qs.begin(), all_qs.end(), [](const auto& a, const auto& b) {
-        return a->state().get() < b->state().get();
-    });
+    // The remaining qubits keep their (now smaller) state
+    Ptr<QuantumStateRegistry> registry = q->registry();
+    registry->Detach({q->handle()});
+    if (m_autoFactorize)
+        registry->Factorize(current_state);
+    ResetMeasured(q, result, current_state->backend());
+    return result;
+}
+
+std::vector<qpp::idx> QuantumComponent::Measure(const std::vector<std::shared_ptr<Qubit>>& qs) {
+    std::vector<qpp::idx> results(qs.size());
 
-    std::vector<std::shared_ptr<QuantumState>> ordered_states;
-    for (const auto& [state, _] : state_groups)
-        ordered_states.push_back(state);
+    // Branching forks on one qubit at a time, which has the same joint
+    // distribution
+    if (BranchingRunner::active()) {
+        for (size_t i = 0; i < qs.size(); ++i)
+            results[i] = Measure(qs[i]);
+        return results;
+    }
 
-    std::sort(ordered_states.begin(), ordered_states.end(), [](const auto& a, const auto& b) {
-        return a.get() < b.get();
-    });
+    // One joint measurement per distinct state, in order of first appearance
+    std::vector<std::pair<QuantumState::Ptr, std::vector<size_t>>> groups;
+    for (size_t i = 0; i < qs.size(); ++i) {
+        auto state = qs[i]->state();
+        auto it = std::find_if(groups.begin(), groups.end(), [&](const auto& g) { return g.first == state; });
+        if (it == groups.end())
+            groups.push_back({state, {i}});
+        else
+            it->second.push_back(i);
+    }
 
-    qpp::ket combined = ordered_states[0]->get_ket();
-    for (size_t i = 1; i < ordered_states.size(); ++i)
-        combined = qpp::kron(combined, ordered_states[i]->get_ket());
+    for (const auto& [state, positions] : groups) {
+        std::vector<qpp::idx> targets;
+        std::vector<QubitHandle> handles;
+        for (size_t pos : positions) {
+            targets.push_back(qs[pos]->index());
+            handles.push_back(qs[pos]->handle());
+        }
+        std::vector<qpp::idx> outcomes = state->measure(targets, m_rng);
+        Ptr<QuantumStateRegistry> registry = qs[positions[0]]->registry();
+        registry->Detach(handles);
+        if (m_autoFactorize)
+            registry->Factorize(state);
+
+        for (size_t j = 0; j < positions.size(); ++j) {
+            results[positions[j]] = outcomes[j];
+            ResetMeasured(qs[positions[j]], outcomes[j], state->backend());
+        }
+    }
+    return results;
+}
+
+std::vector<qpp::idx> QuantumComponent::Measure(const std::vector<std::shared_ptr<Qubit>>& qs, const qpp::cmat& basis) {
+    const qpp::idx dim = static_cast<qpp::idx>(basis.rows());
+    NS_ABORT_MSG_IF(basis.cols() != basis.rows() || (dim != 2 && dim != (qpp::idx{1} << qs.size())),
+                    "a measurement basis is 2x2 or 2^k x 2^k for k qubits");
 
-    auto new_state = std::make_shared<QuantumState>(combined);
-    for (size_t i = 0; i < all_qs.size(); ++i) {
-        all_qs[i]->set_index(i);
-        all_qs[i]->set_state(new_state);
+    // Rotate the basis onto Z, measure, then leave the qubits in the basis state found
+    const bool per_qubit = dim == 2;
+    if (per_qubit) {
+        Gate rotation(qpp::adjoint(basis));
+        for (const auto& q : qs)
+            ApplyGate(rotation, q);
+    } else {
+        ApplyGate(Gate(qpp::adjoint(basis)), qs);
     }
 
-    std::vector<qpp::idx> targets;
-    for (const auto& q : qs)
-        targets.push_back(q->index());
+    std::vector<qpp::idx> results = Measure(qs);
 
-    new_state->apply_gate(gate, targets);
+    if (per_qubit) {
+        Gate back(basis);
+        for (const auto& q : qs)
+            q->state()->apply_gate(back, {0});
+    } else {
+        // basis |outcome⟩, prepared in the component's backend
+        auto post = std::make_shared<QuantumState>(qs.size(), m_backend);
+        std::vector<qpp::idx> targets(qs.size());
+        for (size_t i = 0; i < qs.size(); ++i) {
+            targets[i] = i;
+            if (results[i])
+                post->apply_gate(Gate::X, {i});
+        }
+        post->apply_gate(Gate(basis), targets);
+        for (size_t i = 0; i < qs.size(); ++i) {
+            qs[i]->registry()->Detach({qs[i]->handle()});
+            qs[i]->registry()->Attach(qs[i]->handle(), post, i);
+        }
+    }
+    return results;
 }
 
-qpp::idx QuantumComponent::Measure(std::shared_ptr<Qubit> q) {
-    auto current_state = q->state();
-    auto related_qubits = QuantumStateRegistry::instance().get_qubits(current_state);
+std::vector<qpp::idx> QuantumComponent::SwapEntanglement(const std::shared_ptr<Qubit>& a, const std::shared_ptr<Qubit>& b) {
+    Ptr<QuantumStateRegistry> registry = a->registry();
+    if (b->registry() != registry)
+        registry->Adopt(b->registry(), b->handle());
+
+    auto state_a = a->state(), state_b = b->state();
+    std::shared_ptr<Qubit> x, y;
+    if (!m_gateErrorModel && state_a != state_b && state_a->backend() == QuantumState::BELL_DIAGONAL &&
+        state_b->backend() == QuantumState::BELL_DIAGONAL) {
+        x = PartnerOf(a);
+        y = PartnerOf(b);
+    }
+    if (!x || !y) {
+        ApplyGate(Gate::CNOT, {a, b});
+        ApplyGate(Gate::H, a);
+        return Measure({a, b});
+    }
 
-    auto [result, collapsed_state] = current_state->measure(q->index());
+    // All four outcomes are equally likely for any Bell-diagonal inputs.
+    // Pairs i and j with outcome (m_a, m_b) leave x and y in Bell state
+    // i ^ j ^ (m_b, m_a), so the new weights are the XOR convolution of the
+    // old ones, shifted by the outcome.
+    const qpp::idx outcome = BranchingRunner::active() ? BranchingRunner::branch({0.25, 0.25, 0.25, 0.25})
+                                                        : m_rng() & 3;
+    const qpp::idx m_a = outcome >> 1, m_b = outcome & 1;
+    const size_t shift = (m_b << 1) | m_a;
+    const auto wa = state_a->get_bell_diagonal().weights();
+    const auto wb = state_b->get_bell_diagonal().weights();
+    std::array<double, 4> w{};
+    for (size_t i = 0; i < 4; ++i)
+        for (size_t j = 0; j < 4; ++j)
+            w[i ^ j ^ shift] += wa[i] * wb[j];
+
+    registry->Detach({a->handle(), x->handle()});
+    registry->Detach({b->handle(), y->handle()});
+    auto pair = std::make_shared<QuantumState>(BellDiagonalState(w));
+    registry->Attach(x->handle(), pair, 0);
+    registry->Attach(y->handle(), pair, 1);
+    ResetMeasured(a, m_a, m_backend);
+    ResetMeasured(b, m_b, m_backend);
+    return {m_a, m_b};
+}
 
-    int removed_index = static_cast<int>(q->index());
-    auto new_state = std::make_shared<QuantumState>(collapsed_state);
+std::shared_ptr<Qubit> QuantumComponent::PartnerOf(const std::shared_ptr<Qubit>& q) const {
+    for (const auto& other : q->registry()->GetQubits(q->state()))
+        if (other != q)
+            return other;
+    return nullptr;
+}
 
-    for (auto& qb : related_qubits) {
-        if (qb == q) continue;
-        int old_idx = static_cast<int>(qb->index());
-        int new_idx = old_idx > removed_index ? old_idx - 1 : old_idx;
-        qb->set_state(new_state);
-        qb->set_index(new_idx);
-    }
+// A detached measured qubit is left alone in |result⟩
+void QuantumComponent::ResetMeasured(const std::shared_ptr<Qubit>& q, qpp::idx result, QuantumState::Backend backend) {
+    auto measured_state = std::make_shared<QuantumState>(1, backend);
+    if (result == 1)
+        measured_state->apply_gate(Gate::X, {0});
+    q->registry()->Attach(q->handle(), measured_state, 0);
+}
 
-    q->set_state(std::make_shared<QuantumState>(result == 0 ? qpp::st.z0 : qpp::st.z1));
-    q->set_index(0);
-    return result;
+void QuantumComponent::Factorize() {
+    std::vector<std::pair<QuantumState::Ptr, Ptr<QuantumStateRegistry>>> states;
+    for (const auto& q : qubits_) {
+        auto state = q->state();
+        auto it = std::find_if(states.begin(), states.end(), [&](const auto& s) { return s.first == state; });
+        if (it == states.end())
+            states.push_back({state, q->registry()});
+    }
+    for (const auto& [state, registry] : states)
+        registry->Factorize(state);
 }
 
 void QuantumComponent::AddDevice(Ptr<QuantumNetDevice> dev) {
@@ -156,14 +341,23 @@ void QuantumComponent::SetReceiveCallback(QubitReceiveCallback cb) {
     receive_callback_ = std::move(cb);
 }
 
+void QuantumComponent::SetTrainReceiveCallback(QubitTrainReceiveCallback cb) {
+    train_receive_callback_ = std::move(cb);
+}
+
 
 
 void QuantumComponent::PrintAllStates() const {
     std::cout << "[QuantumComponent] Printing all states. Number of qubits: " << qubits_.size() << "\n";
     int i = 0;
     for (const auto& q : qubits_) {
-        std::cout << "[QuantumComponent] Qubit " << i << " is index " << q->index() << " in state:\n"
-                  << qpp::disp(q->state()->get_ket()) << "\n";
+        std::cout << "[QuantumComponent] Qubit " << i << " is index " << q->index() << " in state:\n";
+        if (q->state()->backend() == QuantumState::STABILIZER)
+            std::cout << q->state()->get_tableau();
+        else if (q->state()->backend() == QuantumState::DENSITY || q->state()->backend() == QuantumState::BELL_DIAGONAL)
+            std::cout << qpp::disp(q->state()->get_density_matrix()) << "\n";
+        else
+            std::cout << qpp::disp(q->state()->get_ket()) << "\n";
         i++;
     }
     std::cout << "\n\n";
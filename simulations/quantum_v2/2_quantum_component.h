@@ -1,7 +1,9 @@
 #pragma once
 #include "ns3/object.h"
 #include "2_qubit.h"
+#include "2_qubit_train.h"
 #include "2_quantum_net_device.h"
+#include "2_quantum_error_model.h"
 
 #include <memory>
 #include <vector>
@@ -11,35 +13,83 @@ using QubitReceiveCallback = std::function<void(std::shared_ptr<Qubit>)>;
 
 namespace ns3 {
 
+using QubitTrainReceiveCallback = std::function<void(const QubitTrain&)>;
+
 class QuantumComponent : public Object {
 public:
     static TypeId GetTypeId();
 
     QuantumComponent();
 
+    Ptr<QuantumStateRegistry> GetRegistry() const;
+    // Shares registry (the Registry attribute); its streams are then left to
+    // whoever created it
+    void SetRegistry(Ptr<QuantumStateRegistry> registry);
+
+    // Fixes the random streams of this component, then of its registry if
+    // the component created it, and of its gate error model; returns the
+    // number of streams used
+    int64_t AssignStreams(int64_t stream);
+
     std::shared_ptr<Qubit> CreateQubit(const std::string& id = "");
     std::shared_ptr<Qubit> GetQubitById(const std::string& id) const;
 
     void StoreQubit(std::shared_ptr<Qubit> q);
+    // Stores every qubit of train, then hands the whole train to the train
+    // receive callback if one is set, else each qubit to the receive callback
+    void StoreQubits(const QubitTrain& train);
     void RemoveQubit(std::shared_ptr<Qubit> q);
 
 
     std::pair<std::shared_ptr<Qubit>, std::shared_ptr<Qubit>> CreateEntangledPair();
 
-    void ApplyGate(const qpp::cmat& gate, const std::shared_ptr<Qubit>& q);
-    void ApplyGate(const qpp::cmat& gate, const std::vector<std::shared_ptr<Qubit>>& qs);
+    void ApplyGate(const Gate& gate, const std::shared_ptr<Qubit>& q);
+    void ApplyGate(const Gate& gate, const std::vector<std::shared_ptr<Qubit>>& qs);
 
     qpp::idx Measure(std::shared_ptr<Qubit> q);
+    std::vector<qpp::idx> Measure(const std::vector<std::shared_ptr<Qubit>>& qs);
+    // basis columns are the measurement basis, either one qubit's (applied to
+    // each qubit) or the joint 2^k-dimensional basis of all of qs. The
+    // rotation onto it is a gate like any other, GateErrorModel included;
+    // the basis state found is prepared in the component's Backend.
+    std::vector<qpp::idx> Measure(const std::vector<std::shared_ptr<Qubit>>& qs, const qpp::cmat& basis);
+
+    // Bell-state measurement of a and b (CNOT a→b, H on a, measure both),
+    // returning {m_a, m_b}. Swapping a pair (x, a) with a pair (b, y) leaves
+    // x and y entangled, with X^m_b Z^m_a on y as the Pauli correction. When
+    // a and b each hold one half of a Bell-diagonal pair (BellDiagonal
+    // backend), the pair between the partners is written directly and the
+    // outcome sampled uniformly, without building the four-qubit state. Any
+    // other input, or a GateErrorModel, goes gate by gate.
+    std::vector<qpp::idx> SwapEntanglement(const std::shared_ptr<Qubit>& a, const std::shared_ptr<Qubit>& b);
+
+    // Splits the states of stored qubits into independent states wherever
+    // they have become a product. Also run after each measurement when the
+    // AutoFactorize attribute is set (off by default: the check costs one
+    // pass over the state per qubit and per correlated pair).
+    void Factorize();
 
     void AddDevice(Ptr<QuantumNetDevice> dev);
     void SetReceiveCallback(QubitReceiveCallback cb);
+    void SetTrainReceiveCallback(QubitTrainReceiveCallback cb);
 
     void PrintAllStates() const;
 
 private:
-    std::vector<std::shared_ptr<Qubit>> qubits_;
+    void ResetMeasured(const std::shared_ptr<Qubit>& q, qpp::idx result, QuantumState::Backend backend);
+    // The other qubit of q's two-qubit state, or null if it is gone
+    std::shared_ptr<Qubit> PartnerOf(const std::shared_ptr<Qubit>& q) const;
+
+    QubitStore qubits_;
     std::vector<Ptr<QuantumNetDevice>> m_netDevices;
     QubitReceiveCallback receive_callback_;
+    QubitTrainReceiveCallback train_receive_callback_;
+    QuantumState::Backend m_backend;
+    bool m_autoFactorize;
+    Ptr<QuantumStateRegistry> m_registry;
+    bool m_ownsRegistry; // m_registry was created here, not shared
+    Ptr<QuantumErrorModel> m_gateErrorModel;
+    CounterRng m_rng; // measurement outcomes
 };
 
 }
\ No newline at end of file
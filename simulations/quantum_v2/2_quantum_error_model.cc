@@ -0,0 +1,198 @@
+#include "2_quantum_error_model.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED(QuantumErrorModel);
+
+namespace {
+
+qpp::cmat superoperator_from_kraus(const std::vector<qpp::cmat>& kraus) {
+    const Eigen::Index d = kraus[0].rows();
+    qpp::cmat S = qpp::cmat::Zero(d * d, d * d);
+    for (const auto& K : kraus)
+        S += qpp::kron(qpp::cmat(K.conjugate()), K);
+    return S;
+}
+
+}
+
+TypeId QuantumErrorModel::GetTypeId() {
+    static TypeId tid = TypeId("ns3::QuantumErrorModel")
+        .SetParent<Object>()
+        .SetGroupName("Quantum")
+        .AddConstructor<QuantumErrorModel>()
+        .AddAttribute("Depolarizing",
+                      "Probability of a uniformly random Pauli error",
+                      DoubleValue(0.0),
+                      MakeDoubleAccessor(&QuantumErrorModel::SetDepolarizing,
+                                         &QuantumErrorModel::GetDepolarizing),
+                      MakeDoubleChecker<double>(0.0, 1.0))
+        .AddAttribute("Dephasing",
+                      "Probability of a Z error",
+                      DoubleValue(0.0),
+                      MakeDoubleAccessor(&QuantumErrorModel::SetDephasing,
+                                         &QuantumErrorModel::GetDephasing),
+                      MakeDoubleChecker<double>(0.0, 1.0))
+        .AddAttribute("AmplitudeDamping",
+                      "Probability of decaying from |1⟩ to |0⟩",
+                      DoubleValue(0.0),
+                      MakeDoubleAccessor(&QuantumErrorModel::SetAmplitudeDamping,
+                                         &QuantumErrorModel::GetAmplitudeDamping),
+                      MakeDoubleChecker<double>(0.0, 1.0))
+        .AddAttribute("Mode",
+                      "Exact superoperators on density matrices, or sampled Kraus jumps on kets",
+                      EnumValue(QuantumErrorModel::SUPEROPERATOR),
+                      MakeEnumAccessor<Mode>(&QuantumErrorModel::SetMode, &QuantumErrorModel::GetMode),
+                      MakeEnumChecker(QuantumErrorModel::SUPEROPERATOR, "Superoperator",
+                                      QuantumErrorModel::TRAJECTORY, "Trajectory"));
+    return tid;
+}
+
+QuantumErrorModel::QuantumErrorModel()
+    : m_depolarizing(0.0), m_dephasing(0.0), m_amplitudeDamping(0.0), m_mode(SUPEROPERATOR),
+      m_rng(CounterRng::automatic()) {}
+
+void QuantumErrorModel::SetMode(Mode mode) {
+    m_mode = mode;
+}
+
+QuantumErrorModel::Mode QuantumErrorModel::GetMode() const {
+    return m_mode;
+}
+
+void QuantumErrorModel::SetDepolarizing(double p) {
+    m_depolarizing = p;
+    ClearCache();
+}
+
+double QuantumErrorModel::GetDepolarizing() const {
+    return m_depolarizing;
+}
+
+void QuantumErrorModel::SetDephasing(double p) {
+    m_dephasing = p;
+    ClearCache();
+}
+
+double QuantumErrorModel::GetDephasing() const {
+    return m_dephasing;
+}
+
+void QuantumErrorModel::SetAmplitudeDamping(double gamma) {
+    m_amplitudeDamping = gamma;
+    ClearCache();
+}
+
+double QuantumErrorModel::GetAmplitudeDamping() const {
+    return m_amplitudeDamping;
+}
+
+const std::vector<qpp::cmat>& QuantumErrorModel::GetKrausOperators() {
+    if (!m_kraus.empty())
+        return m_kraus;
+
+    const double p = m_depolarizing, q = m_dephasing, g = m_amplitudeDamping;
+    std::vector<qpp::cmat> depolarizing = {std::sqrt(1 - p) * qpp::gt.Id2, std::sqrt(p / 3) * qpp::gt.X,
+                                           std::sqrt(p / 3) * qpp::gt.Y, std::sqrt(p / 3) * qpp::gt.Z};
+    std::vector<qpp::cmat> dephasing = {std::sqrt(1 - q) * qpp::gt.Id2, std::sqrt(q) * qpp::gt.Z};
+    qpp::cmat a0(2, 2), a1(2, 2);
+    a0 << 1, 0, 0, std::sqrt(1 - g);
+    a1 << 0, std::sqrt(g), 0, 0;
+
+    for (const auto& A : {a0, a1})
+        for (const auto& B : dephasing)
+            for (const auto& C : depolarizing)
+                if ((A * B * C).norm() > 0)
+                    m_kraus.push_back(A * B * C);
+    return m_kraus;
+}
+
+const qpp::cmat& QuantumErrorModel::GetSuperoperator(size_t num_qubits) {
+    if (m_noiseCache.size() <= num_qubits)
+        m_noiseCache.resize(num_qubits + 1);
+    qpp::cmat& S = m_noiseCache[num_qubits];
+    if (S.size() > 0)
+        return S;
+
+    // Entry (i, j) on {columns, rows} of the qubits is the product of the
+    // single-qubit entries at each qubit's (column bit, row bit)
+    const qpp::cmat S1 = superoperator_from_kraus(GetKrausOperators());
+    const size_t k = num_qubits;
+    const Eigen::Index D = Eigen::Index{1} << (2 * k);
+    auto local = [k](Eigen::Index i, size_t m) {
+        return (((i >> (2 * k - 1 - m)) & 1) << 1) | ((i >> (k - 1 - m)) & 1);
+    };
+    S = qpp::cmat(D, D);
+    for (Eigen::Index i = 0; i < D; ++i) {
+        for (Eigen::Index j = 0; j < D; ++j) {
+            qpp::cplx entry = 1;
+            for (size_t m = 0; m < k; ++m)
+                entry *= S1(local(i, m), local(j, m));
+            S(i, j) = entry;
+        }
+    }
+    return S;
+}
+
+const qpp::cmat& QuantumErrorModel::GetSuperoperator(const Gate& gate) {
+    // Only named kinds are cached; a global phase leaves the superoperator
+    // unchanged, so the kind alone is the key. Arbitrary matrices, such as
+    // rotations by sampled angles, would grow the cache without bound.
+    if (gate.kind() == Gate::GENERIC) {
+        m_genericGate = GetSuperoperator(gate.num_qubits()) * superoperator_from_kraus({gate.matrix()});
+        return m_genericGate;
+    }
+    if (m_gateCache.size() <= gate.kind())
+        m_gateCache.resize(gate.kind() + 1);
+    qpp::cmat& S = m_gateCache[gate.kind()];
+    if (S.size() == 0)
+        S = GetSuperoperator(gate.num_qubits()) * superoperator_from_kraus({gate.matrix()});
+    return S;
+}
+
+void QuantumErrorModel::ApplyGate(QuantumState& state, const Gate& gate, const std::vector<qpp::idx>& targets) {
+    if (m_mode == SUPEROPERATOR && state.backend() != QuantumState::BELL_DIAGONAL) {
+        state.apply_superoperator(GetSuperoperator(gate), targets);
+        return;
+    }
+    state.apply_gate(gate, targets);
+    ApplyNoise(state, targets);
+}
+
+void QuantumErrorModel::ApplyNoise(QuantumState& state, const std::vector<qpp::idx>& targets) {
+    // Without amplitude damping the noise is a Pauli channel, which keeps a
+    // Bell-diagonal pair Bell-diagonal in either mode
+    if (state.backend() == QuantumState::BELL_DIAGONAL && m_amplitudeDamping == 0) {
+        const double p = m_depolarizing, q = m_dephasing;
+        for (qpp::idx t : targets) {
+            state.apply_pauli_channel({1 - p, p / 3, p / 3, p / 3}, t);
+            state.apply_pauli_channel({1 - q, q, 0, 0}, t);
+        }
+        return;
+    }
+    if (m_mode == SUPEROPERATOR) {
+        state.apply_superoperator(GetSuperoperator(targets.size()), targets);
+        return;
+    }
+    for (qpp::idx t : targets)
+        state.apply_kraus(GetKrausOperators(), t, m_rng);
+}
+
+void QuantumErrorModel::Apply(const std::shared_ptr<Qubit>& q) {
+    ApplyNoise(*q->state(), {q->index()});
+}
+
+int64_t QuantumErrorModel::AssignStreams(int64_t stream) {
+    m_rng = CounterRng::from_seed_manager(stream);
+    return 1;
+}
+
+void QuantumErrorModel::ClearCache() {
+    m_kraus.clear();
+    m_noiseCache.clear();
+    m_gateCache.clear();
+}
+
+}
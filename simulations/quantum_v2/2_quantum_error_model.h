@@ -0,0 +1,76 @@
+#pragma once
+#include "ns3/object.h"
+#include "2_gate.h"
+#include "2_qubit.h"
+
+#include <memory>
+#include <vector>
+
+namespace ns3 {
+
+// Noise acting independently on every qubit it touches: depolarizing, then
+// dephasing, then amplitude damping. A channel applies it to each qubit in
+// transit and a component after each gate.
+//
+// In SUPEROPERATOR mode the exact channel acts on a density matrix.
+// Superoperators are built once per (named gate, noise) combination and
+// cached, since the same few combinations are applied over and over; other
+// gate matrices are rebuilt on every use. In TRAJECTORY mode states stay
+// kets and each application samples one Kraus operator; averaging
+// observables over many runs (see TrajectoryRunner) recovers the
+// density-matrix result at ket memory cost. Either way, a Bell-diagonal pair
+// takes depolarizing and dephasing exactly, in closed form.
+class QuantumErrorModel : public Object {
+public:
+    static TypeId GetTypeId();
+
+    enum Mode { SUPEROPERATOR, TRAJECTORY };
+
+    QuantumErrorModel();
+
+    void SetMode(Mode mode);
+    Mode GetMode() const;
+
+    void SetDepolarizing(double p);
+    double GetDepolarizing() const;
+    void SetDephasing(double p);
+    double GetDephasing() const;
+    void SetAmplitudeDamping(double gamma);
+    double GetAmplitudeDamping() const;
+
+    // Kraus operators of the single-qubit channel
+    const std::vector<qpp::cmat>& GetKrausOperators();
+
+    // The noise alone on num_qubits qubits
+    const qpp::cmat& GetSuperoperator(size_t num_qubits);
+    // gate followed by the noise on each of its qubits. For a GENERIC gate
+    // the result is only good until the next call
+    const qpp::cmat& GetSuperoperator(const Gate& gate);
+
+    // gate on targets of state followed by the noise, per the mode
+    void ApplyGate(QuantumState& state, const Gate& gate, const std::vector<qpp::idx>& targets);
+    // The noise alone on targets of state
+    void ApplyNoise(QuantumState& state, const std::vector<qpp::idx>& targets);
+    // Noise on a single qubit, e.g. one in transit
+    void Apply(const std::shared_ptr<Qubit>& q);
+
+    // Fixes the stream trajectory sampling draws from; returns the number of
+    // streams used (1)
+    int64_t AssignStreams(int64_t stream);
+
+private:
+    void ClearCache();
+
+    double m_depolarizing;
+    double m_dephasing;
+    double m_amplitudeDamping;
+    Mode m_mode;
+    CounterRng m_rng;
+
+    std::vector<qpp::cmat> m_kraus;
+    std::vector<qpp::cmat> m_noiseCache; // indexed by number of qubits
+    std::vector<qpp::cmat> m_gateCache; // indexed by Gate::Kind
+    qpp::cmat m_genericGate; // the last GENERIC gate's, rebuilt on each use
+};
+
+}
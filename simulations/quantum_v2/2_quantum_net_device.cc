@@ -2,8 +2,12 @@
 #include "2_quantum_channel.h"
 #include "2_quantum_component.h"
 #include "ns3/log.h"
+#include "ns3/abort.h"
 #include "ns3/simulator.h"
 #include "ns3/node.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
 
 
 namespace ns3 {
@@ -14,26 +18,144 @@ TypeId QuantumNetDevice::GetTypeId() {
     static TypeId tid = TypeId("ns3::QuantumNetDevice")
         .SetParent<NetDevice>()
         .SetGroupName("Quantum")
-        .AddConstructor<QuantumNetDevice>();
+        .AddConstructor<QuantumNetDevice>()
+        .AddAttribute("EmissionRate",
+                      "Qubits emitted per second; 0 emits without serialization delay",
+                      DoubleValue(0.0),
+                      MakeDoubleAccessor(&QuantumNetDevice::m_emissionRate),
+                      MakeDoubleChecker<double>(0.0))
+        .AddAttribute("MaxQueueSize",
+                      "Qubits the transmit queue holds before refusing sends",
+                      UintegerValue(100),
+                      MakeUintegerAccessor(&QuantumNetDevice::m_maxQueueSize),
+                      MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("Mtu",
+                      "The MAC-level Maximum Transmission Unit",
+                      UintegerValue(1500),
+                      MakeUintegerAccessor(&QuantumNetDevice::SetMtu, &QuantumNetDevice::GetMtu),
+                      MakeUintegerChecker<uint16_t>())
+        .AddTraceSource("QueueOccupancy",
+                        "Number of qubits waiting in the transmit queue",
+                        MakeTraceSourceAccessor(&QuantumNetDevice::m_occupancy),
+                        "ns3::TracedValueCallback::Uint32")
+        .AddTraceSource("TxDrop",
+                        "A qubit refused because the transmit queue was full",
+                        MakeTraceSourceAccessor(&QuantumNetDevice::m_txDropTrace),
+                        "ns3::QuantumNetDevice::QubitTracedCallback");
     return tid;
 }
 
 QuantumNetDevice::QuantumNetDevice()
-    : m_index(0) {}
+    : m_index(0), m_mtu(1500), m_linkUp(false),
+      m_emissionRate(0.0), m_maxQueueSize(100), m_busy(false), m_stopped(false),
+      m_occupancy(0) {}
 
 void QuantumNetDevice::Attach(Ptr<QuantumChannel> channel) {
     m_channel = channel;
+    m_linkUp = true;
+    m_linkChangeCallbacks();
 }
 
 void QuantumNetDevice::SetComponent(Ptr<QuantumComponent> component) {
     m_component = component;
 }
 
-void QuantumNetDevice::SendQubit(std::shared_ptr<Qubit> q) {
+// An idle transmitter takes a send straight away; only what has to wait
+// counts against the queue size
+bool QuantumNetDevice::SendQubit(std::shared_ptr<Qubit> q) {
+    if (!m_channel)
+        return false;
+    if (!m_busy && m_queue.empty()) {
+        m_component->RemoveQubit(q);
+        m_channel->Transmit(std::move(q));
+        Hold(Period());
+        return true;
+    }
+    if (m_occupancy + 1 > m_maxQueueSize) {
+        m_stopped = true;
+        m_txDropTrace(q);
+        return false;
+    }
+
+    m_component->RemoveQubit(q);
+    m_queue.push_back({{std::move(q)}, {Time()}});
+    m_occupancy += 1;
+    return true;
+}
+
+bool QuantumNetDevice::SendQubits(QubitTrain train) {
+    NS_ABORT_MSG_IF(train.offsets.size() != train.qubits.size(), "a train needs one offset per qubit");
+    if (!m_channel)
+        return false;
+    if (train.qubits.empty())
+        return true;
+    const uint32_t size = static_cast<uint32_t>(train.qubits.size());
+    if ((m_busy || !m_queue.empty()) && m_occupancy + size > m_maxQueueSize) {
+        m_stopped = true;
+        for (const auto& q : train.qubits)
+            m_txDropTrace(q);
+        return false;
+    }
+
+    for (const auto& q : train.qubits)
+        m_component->RemoveQubit(q);
+    if (!m_busy && m_queue.empty()) {
+        Emit(std::move(train));
+        return true;
+    }
+    m_queue.push_back(std::move(train));
+    m_occupancy += size;
+    return true;
+}
+
+uint32_t QuantumNetDevice::GetQueueOccupancy() const {
+    return m_occupancy;
+}
+
+bool QuantumNetDevice::IsQueueFull() const {
+    return m_occupancy >= m_maxQueueSize;
+}
+
+void QuantumNetDevice::SetWakeCallback(std::function<void()> cb) {
+    m_wake = std::move(cb);
+}
+
+Time QuantumNetDevice::Period() const {
+    return m_emissionRate > 0 ? Seconds(1.0 / m_emissionRate) : Time();
+}
+
+// A train holds the transmitter until its last qubit has been emitted
+void QuantumNetDevice::Emit(QubitTrain train) {
+    const Time busy = train.offsets.back() + Period();
+    if (train.qubits.size() == 1 && train.offsets[0].IsZero())
+        m_channel->Transmit(std::move(train.qubits[0]));
+    else
+        m_channel->TransmitTrain(std::move(train));
+    Hold(busy);
+}
+
+void QuantumNetDevice::Hold(Time busy) {
+    if (!busy.IsStrictlyPositive())
+        return;
+    m_busy = true;
+    Simulator::Schedule(busy, &QuantumNetDevice::TransmitComplete, this);
+}
+
+void QuantumNetDevice::TransmitComplete() {
+    m_busy = false;
+    while (!m_busy && !m_queue.empty()) {
+        QubitTrain train = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_occupancy -= static_cast<uint32_t>(train.qubits.size());
+        Emit(std::move(train));
+    }
 
-    if (m_channel) {
-        m_component->RemoveQubit(q); // Maybe this should also be scheduled?
-        m_channel->Transmit(q);
+    // Last, so a sender refilling the queue from the callback finds the
+    // transmitter in its final state
+    if (m_stopped && !IsQueueFull()) {
+        m_stopped = false;
+        if (m_wake)
+            m_wake();
     }
 }
 
@@ -49,4 +171,21 @@ Ptr<Node> QuantumNetDevice::GetNode() const {
     return m_node;
 }
 
-}
\ No newline at end of file
+bool QuantumNetDevice::SetMtu(uint16_t mtu) {
+    m_mtu = mtu;
+    return true;
+}
+
+uint16_t QuantumNetDevice::GetMtu() const {
+    return m_mtu;
+}
+
+bool QuantumNetDevice::IsLinkUp() const {
+    return m_linkUp;
+}
+
+void QuantumNetDevice::AddLinkChangeCallback(Callback<void> callback) {
+    m_linkChangeCallbacks.ConnectWithoutContext(callback);
+}
+
+}
@@ -1,7 +1,13 @@
 #pragma once
 #include "ns3/net-device.h"
 #include "ns3/ptr.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
 #include "2_qubit.h"
+#include "2_qubit_train.h"
+#include <deque>
+#include <functional>
 #include <memory>
 
 namespace ns3 {
@@ -9,18 +15,40 @@ namespace ns3 {
 class QuantumChannel;
 class QuantumComponent;
 
+// Emits qubits onto a QuantumChannel from a transmit queue, in the manner of
+// PointToPointNetDevice: a qubit (or train) waits in the queue until the
+// transmitter is free, then holds it for one emission period (1 /
+// EmissionRate, plus the train's last offset) while it goes out. A send
+// that has to wait but does not fit in the queue's MaxQueueSize qubits is
+// refused: it returns false, the qubits stay with the sender and TxDrop
+// fires. That is the backpressure; the wake callback tells the sender once
+// room frees up.
+// With an EmissionRate of 0 there is no serialization delay and qubits go
+// out as soon as they are sent.
 class QuantumNetDevice : public NetDevice {
 public:
     static TypeId GetTypeId();
 
+    typedef void (*QubitTracedCallback)(std::shared_ptr<Qubit> q);
+
     QuantumNetDevice();
 
     void Attach(Ptr<QuantumChannel> channel);
     void SetComponent(Ptr<QuantumComponent> component);
 
-    void SendQubit(std::shared_ptr<Qubit> q);
+    // Queues q for transmission; false if the device has no channel or the
+    // queue is full
+    bool SendQubit(std::shared_ptr<Qubit> q);
+    // All of train in one transmission (see QuantumChannel::TransmitTrain),
+    // queued as a whole; false if it has to wait and does not fit
+    bool SendQubits(QubitTrain train);
+
+    // Qubits waiting to be emitted
+    uint32_t GetQueueOccupancy() const;
+    bool IsQueueFull() const;
+    // Called when room frees up in a queue that has refused a send
+    void SetWakeCallback(std::function<void()> cb);
 
-    // Minimal overrides for now
     Ptr<Channel> GetChannel() const override;
     void SetNode(Ptr<Node> node) override;
     Ptr<Node> GetNode() const override;
@@ -31,11 +59,12 @@ public:
     void SetIfIndex(uint32_t index) override { m_index = index; }
     uint32_t GetIfIndex() const override { return m_index; }
 
-    bool SetMtu(uint16_t mtu) override { return true; }
-    uint16_t GetMtu() const override { return 1500; }
+    bool SetMtu(uint16_t mtu) override;
+    uint16_t GetMtu() const override;
 
-    bool IsLinkUp() const override { return true; }
-    void AddLinkChangeCallback(Callback<void> callback) override {}
+    // Up once attached to a channel
+    bool IsLinkUp() const override;
+    void AddLinkChangeCallback(Callback<void> callback) override;
 
     bool IsBroadcast() const override { return false; }
     Address GetBroadcast() const override { return Address(); }
@@ -49,6 +78,7 @@ public:
 
     bool NeedsArp() const override { return false; }
 
+    // Classical packets take a classical device; this one only carries qubits
     void SetReceiveCallback(ReceiveCallback cb) override {}
     void SetPromiscReceiveCallback(PromiscReceiveCallback cb) override {}
     bool SupportsSendFrom() const override { return false; }
@@ -58,10 +88,31 @@ public:
 
 
 private:
+    // One emission period, zero without an EmissionRate
+    Time Period() const;
+    void Emit(QubitTrain train);
+    // Marks the transmitter busy for busy, if positive
+    void Hold(Time busy);
+    // Frees the transmitter and emits queued trains until one holds it again
+    void TransmitComplete();
+
     uint32_t m_index;
+    uint16_t m_mtu;
     Ptr<Node> m_node;
     Ptr<QuantumChannel> m_channel;
     Ptr<QuantumComponent> m_component;
+    bool m_linkUp;
+    TracedCallback<> m_linkChangeCallbacks;
+
+    double m_emissionRate; // qubits per second, 0 for no serialization delay
+    uint32_t m_maxQueueSize;
+    std::deque<QubitTrain> m_queue;
+    bool m_busy;    // transmitter emitting
+    bool m_stopped; // a send was refused since the queue last had room
+    std::function<void()> m_wake;
+
+    TracedValue<uint32_t> m_occupancy;
+    TracedCallback<std::shared_ptr<Qubit>> m_txDropTrace;
 };
 
-} 
+}
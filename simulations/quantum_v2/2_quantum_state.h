@@ -1,60 +1,517 @@
 #pragma once
 #include "qpp/qpp.hpp"
+#include "ns3/abort.h"
+#include "2_bell_diagonal_state.h"
+#include "2_counter_rng.h"
+#include "2_stabilizer_state.h"
+#include "2_state_vector_kernels.h"
+#include "2_density_kernels.h"
 #include <memory>
 #include <vector>
+#include <algorithm>
 #include <cmath>
+#include <numeric>
 
 using namespace qpp;
 
 class QuantumState {
 public:
     using Ptr = std::shared_ptr<QuantumState>;
-    QuantumState(size_t num_qubits);
+
+    // KET keeps dense amplitudes. STABILIZER keeps a Clifford tableau and
+    // falls back to KET the first time a non-Clifford gate is applied.
+    // DENSITY keeps the density matrix, so noise channels can act on it;
+    // the other backends are promoted to it by the first channel applied.
+    // BELL_DIAGONAL keeps a two-qubit pair as its four Bell-state weights,
+    // which Pauli gates and Pauli channels update in closed form; any other
+    // operation turns it into a ket (a pure pair) or a density matrix.
+    // Fresh states asked for with BELL_DIAGONAL start as kets, since |0...0⟩
+    // is not Bell-diagonal; pairs come from the BellDiagonalState constructor.
+    enum Backend { KET, STABILIZER, DENSITY, BELL_DIAGONAL };
+
+    QuantumState(size_t num_qubits, Backend backend = KET);
     QuantumState(qpp::ket state);
+    QuantumState(StabilizerState tableau);
+    QuantumState(const qpp::cmat& rho);
+    QuantumState(const BellDiagonalState& pair);
+
+    Backend backend() const;
 
     cmat get_density_matrix() const;
+    // For DENSITY, the eigenvector of largest weight (exact for pure states)
     ket get_ket() const;
+    const StabilizerState& get_tableau() const;
+    // Weights on the Bell states of a two-qubit state: the stored ones for
+    // BELL_DIAGONAL, otherwise those of the density matrix
+    BellDiagonalState get_bell_diagonal() const;
+
+    // 1- and 2-qubit gates on a ket or density matrix are queued rather than
+    // applied: a gate is multiplied into the latest queued gate on the same
+    // qubits when their targets together span at most two qubits, so a run
+    // of gates on one qubit or one pair costs a single pass over the state.
+    // Reads, measurements, channels and merges flush the queue first.
+    void apply_gate(const Gate& gate, const std::vector<idx>& targets);
+    // Applies any queued gates
+    void flush() const;
+    // Applies a channel given as its superoperator Σ K* ⊗ K on targets,
+    // in place on the density matrix
+    void apply_superoperator(const cmat& S, const std::vector<idx>& targets);
+    // Quantum-trajectory step for a single-qubit channel: picks one Kraus
+    // operator with its Born probability and applies it, renormalized, so a
+    // ket stays a ket. Mixtures of unitaries (e.g. Pauli channels) are
+    // sampled without reading the state and keep a tableau a tableau. A
+    // DENSITY state gets the whole channel instead.
+    void apply_kraus(const std::vector<cmat>& kraus, idx target, CounterRng& rng = CounterRng::thread_default());
+    // The Pauli channel ρ → Σ_P p_P P ρ P on target, probabilities indexed
+    // I, Z, X, Y. Exact in closed form on a Bell-diagonal pair; promotes
+    // other backends to DENSITY.
+    void apply_pauli_channel(const BellDiagonalState::PauliProbabilities& probabilities, idx target);
+    // Bilateral twirl of a two-qubit state: leaves the Werner state with the
+    // same fidelity to Φ+, as BELL_DIAGONAL
+    void twirl();
+    // Z-basis measurement that collapses in place and removes target, leaving
+    // the state of the remaining qubits (indices above target shift down).
+    // Outcomes are drawn from rng, normally the stream of the component
+    // measuring.
+    idx measure(const idx& target, CounterRng& rng = CounterRng::thread_default());
+    // Joint Z-basis measurement of several qubits in one pass; results are in
+    // the order of targets and all targets are removed
+    std::vector<idx> measure(const std::vector<idx>& targets, CounterRng& rng = CounterRng::thread_default());
+    // Probability that measuring target gives 1
+    double probability(idx target) const;
+    // Measurement of target postselected on outcome, whose probability p
+    // (from probability()) must be nonzero; target is removed as by measure()
+    void collapse(idx target, idx outcome, double p);
 
-    void apply_gate(const cmat& U, const std::vector<idx>& targets);
-    std::pair<idx, qpp::ket> measure(const idx& target);
+    // Tensor product with other; other's qubits are appended after ours
+    void append(const QuantumState& other);
+
+    // Partial trace over target (indices above it shift down); promotes the
+    // state to DENSITY
+    void trace_out(idx target);
+
+    // A subsystem split off by factorize(): its qubits' indices in the state
+    // before the split (ascending) and their own state
+    struct Factor {
+        std::vector<idx> qubits;
+        ket state;
+    };
+    // Splits off groups of qubits that are in a product state with the rest,
+    // keeping the remaining qubits in order. Only the dense ket is factored;
+    // a tableau already costs polynomial space.
+    std::vector<Factor> factorize();
 
     size_t num_qubits() const;
 
 private:
-    ket state_;
+    struct PendingGate {
+        Gate gate;
+        std::vector<idx> targets;
+    };
+    static constexpr size_t kMaxPending = 64;
+
+    // U, acting on targets, as a matrix on the (one or two) qubits of span
+    static cmat embed(const cmat& U, const std::vector<idx>& targets, const std::vector<idx>& span);
+    void to_ket();
+    void to_density();
+    // Turns a Bell-diagonal pair into a ket if it is pure, a density matrix
+    // otherwise; no-op for other backends
+    void from_bell_diagonal();
+
+    Backend backend_;
+    // Queued gates are part of the state's value, so const reads may flush
+    mutable ket state_;
+    StabilizerState tableau_;
+    BellDiagonalState pair_;
+    mutable ket rho_; // vec(ρ), column-major, for DENSITY
+    mutable std::vector<PendingGate> pending_;
 
 };
 
 
 // ----------- Inline implementations ------------
-inline QuantumState::QuantumState(size_t num_qubits) {
-    state_ = qpp::mket(std::vector<idx>(num_qubits, 0)); // |00...0⟩
+inline QuantumState::QuantumState(size_t num_qubits, Backend backend) : backend_(backend) {
+    if (backend_ == BELL_DIAGONAL)
+        backend_ = KET;
+    if (backend_ == STABILIZER) {
+        tableau_ = StabilizerState(num_qubits);
+    } else if (backend_ == DENSITY) {
+        rho_ = ket::Zero(idx{1} << (2 * num_qubits));
+        rho_(0) = 1; // |00...0⟩⟨00...0|
+    } else {
+        state_ = qpp::mket(std::vector<idx>(num_qubits, 0)); // |00...0⟩
+    }
 }
 
-inline QuantumState::QuantumState(qpp::ket state) {
+inline QuantumState::QuantumState(qpp::ket state) : backend_(KET) {
     state_ = state;
 }
 
+inline QuantumState::QuantumState(StabilizerState tableau)
+    : backend_(STABILIZER), tableau_(std::move(tableau)) {}
+
+inline QuantumState::QuantumState(const qpp::cmat& rho)
+    : backend_(DENSITY), rho_(Eigen::Map<const ket>(rho.data(), rho.size())) {}
+
+inline QuantumState::QuantumState(const BellDiagonalState& pair) : backend_(BELL_DIAGONAL), pair_(pair) {}
+
+inline QuantumState::Backend QuantumState::backend() const {
+    return backend_;
+}
+
 inline cmat QuantumState::get_density_matrix() const {
-    return qpp::prj(state_);
+    if (backend_ == BELL_DIAGONAL)
+        return pair_.to_density_matrix();
+    flush();
+    if (backend_ == DENSITY) {
+        const Eigen::Index D = Eigen::Index{1} << num_qubits();
+        return Eigen::Map<const cmat>(rho_.data(), D, D);
+    }
+    return qpp::prj(get_ket());
 }
 
 inline ket QuantumState::get_ket() const {
-    return state_;
+    if (backend_ == BELL_DIAGONAL) {
+        BellDiagonalState::Bell bell;
+        pair_.is_pure(&bell);
+        return BellDiagonalState::bell_ket(bell);
+    }
+    flush();
+    if (backend_ == DENSITY) {
+        Eigen::SelfAdjointEigenSolver<cmat> eig(get_density_matrix());
+        return eig.eigenvectors().col(eig.eigenvalues().size() - 1);
+    }
+    return backend_ == STABILIZER ? tableau_.to_ket() : state_;
+}
+
+inline const StabilizerState& QuantumState::get_tableau() const {
+    return tableau_;
+}
+
+inline BellDiagonalState QuantumState::get_bell_diagonal() const {
+    if (backend_ == BELL_DIAGONAL)
+        return pair_;
+    NS_ABORT_MSG_IF(num_qubits() != 2, "Bell-state weights are only defined for two qubits");
+    return BellDiagonalState::from_density_matrix(get_density_matrix());
+}
+
+inline void QuantumState::apply_gate(const Gate& gate, const std::vector<idx>& targets) {
+    // The kernels index amplitudes by target bits unchecked, and a queued
+    // gate would only fail at some later flush, so bad targets stop here
+    NS_ABORT_MSG_IF(targets.size() != gate.num_qubits(), "gate applied to the wrong number of targets");
+    for (size_t i = 0; i < targets.size(); ++i) {
+        NS_ABORT_MSG_IF(targets[i] >= num_qubits(), "gate target out of range");
+        NS_ABORT_MSG_IF(std::find(targets.begin(), targets.begin() + i, targets[i]) != targets.begin() + i,
+                        "gate targets must be distinct");
+    }
+
+    if (backend_ == BELL_DIAGONAL) {
+        if (pair_.apply_gate(gate))
+            return;
+        from_bell_diagonal();
+    }
+    if (backend_ == STABILIZER) {
+        if (tableau_.apply_gate(gate, targets))
+            return;
+        to_ket();
+    }
+    if (gate.kind() == Gate::IDENTITY)
+        return;
+    if (targets.size() > 2) {
+        flush();
+        if (backend_ == DENSITY)
+            kernels::apply_density(rho_, gate, targets, num_qubits());
+        else
+            kernels::apply(state_, gate, targets, num_qubits());
+        return;
+    }
+
+    // Absorb the latest queued gate touching these qubits as long as the
+    // span stays within two qubits. Nothing queued after it touches them,
+    // so the fused gate can take its place.
+    cmat U = gate.matrix();
+    std::vector<idx> span = targets;
+    size_t pos = pending_.size();
+    while (pos > 0) {
+        size_t j = pos;
+        while (j > 0 && std::none_of(pending_[j - 1].targets.begin(), pending_[j - 1].targets.end(),
+                                     [&](idx t) { return std::find(span.begin(), span.end(), t) != span.end(); }))
+            --j;
+        if (j == 0)
+            break;
+        const PendingGate& prev = pending_[j - 1];
+        std::vector<idx> merged = span;
+        for (idx t : prev.targets)
+            if (std::find(merged.begin(), merged.end(), t) == merged.end())
+                merged.push_back(t);
+        if (merged.size() > 2)
+            break;
+        U = embed(U, span, merged) * embed(prev.gate.matrix(), prev.targets, merged);
+        span = merged;
+        pending_.erase(pending_.begin() + (j - 1));
+        pos = j - 1;
+    }
+    pending_.insert(pending_.begin() + pos, PendingGate{Gate(U), span});
+    if (pending_.size() > kMaxPending)
+        flush();
+}
+
+inline void QuantumState::flush() const {
+    if (pending_.empty())
+        return;
+    const idx n = num_qubits();
+    for (const auto& p : pending_) {
+        if (p.gate.kind() == Gate::IDENTITY)
+            continue;
+        if (backend_ == DENSITY)
+            kernels::apply_density(rho_, p.gate, p.targets, n);
+        else
+            kernels::apply(state_, p.gate, p.targets, n);
+    }
+    pending_.clear();
+}
+
+inline cmat QuantumState::embed(const cmat& U, const std::vector<idx>& targets, const std::vector<idx>& span) {
+    if (targets == span)
+        return U;
+    if (targets.size() == 1)
+        return targets[0] == span[0] ? cmat(qpp::kron(U, qpp::gt.Id2)) : cmat(qpp::kron(qpp::gt.Id2, U));
+    return qpp::gt.SWAP * U * qpp::gt.SWAP; // same pair, reversed order
+}
+
+inline void QuantumState::apply_kraus(const std::vector<cmat>& kraus, idx target, CounterRng& rng) {
+    from_bell_diagonal();
+    if (backend_ == DENSITY) {
+        flush();
+        cmat S = cmat::Zero(4, 4);
+        for (const auto& K : kraus)
+            S += qpp::kron(cmat(K.conjugate()), K);
+        kernels::apply_superoperator(rho_, S, {target}, num_qubits());
+        return;
+    }
+
+    // K†K ∝ I means a fixed probability ||K||²/2 whatever the state
+    bool unitary_mixture = true;
+    std::vector<double> probs;
+    for (const auto& K : kraus) {
+        cmat KK = K.adjoint() * K;
+        unitary_mixture = unitary_mixture && (KK - KK(0, 0) * cmat::Identity(2, 2)).norm() < 1e-12;
+        probs.push_back(KK(0, 0).real());
+    }
+    if (!unitary_mixture) {
+        to_ket();
+        flush();
+        cmat rho = kernels::marginal(state_, num_qubits(), {target});
+        for (size_t i = 0; i < kraus.size(); ++i)
+            probs[i] = (kraus[i].adjoint() * kraus[i] * rho).trace().real();
+    }
+
+    const double u = rng.uniform();
+    size_t chosen = 0;
+    double acc = 0;
+    for (size_t i = 0; i < kraus.size(); ++i) {
+        if (probs[i] <= 0)
+            continue;
+        acc += probs[i];
+        chosen = i;
+        if (u < acc)
+            break;
+    }
+
+    cmat K = kraus[chosen] / std::sqrt(probs[chosen]);
+    if (unitary_mixture)
+        apply_gate(Gate(K), {target});
+    else
+        kernels::apply_matrix(state_, K, {target}, num_qubits());
+}
+
+inline void QuantumState::apply_superoperator(const cmat& S, const std::vector<idx>& targets) {
+    to_density();
+    kernels::apply_superoperator(rho_, S, targets, num_qubits());
 }
 
-inline void QuantumState::apply_gate(const cmat& U, const std::vector<idx>& targets) {
-   state_ = qpp::apply(state_, U, targets);
+inline void QuantumState::apply_pauli_channel(const BellDiagonalState::PauliProbabilities& probabilities, idx target) {
+    if (backend_ == BELL_DIAGONAL) {
+        pair_.apply_pauli_channel(probabilities);
+        return;
+    }
+    const cmat paulis[] = {qpp::gt.Id2, qpp::gt.Z, qpp::gt.X, qpp::gt.Y};
+    cmat S = cmat::Zero(4, 4);
+    for (int j = 0; j < 4; ++j)
+        S += probabilities[j] * qpp::kron(cmat(paulis[j].conjugate()), paulis[j]);
+    apply_superoperator(S, {target});
+}
+
+inline void QuantumState::twirl() {
+    NS_ABORT_MSG_IF(num_qubits() != 2, "twirl acts on a two-qubit state");
+    if (backend_ != BELL_DIAGONAL) {
+        pair_ = get_bell_diagonal();
+        state_ = ket();
+        rho_ = ket();
+        tableau_ = StabilizerState();
+        pending_.clear();
+        backend_ = BELL_DIAGONAL;
+    }
+    pair_.twirl();
 }
 
 // Single qubit measurement
-inline std::pair<idx, qpp::ket> QuantumState::measure(const idx& target) {
-    auto [result, probs, states] = qpp::measure(state_, qpp::gt.Z, {target});
+inline idx QuantumState::measure(const idx& target, CounterRng& rng) {
+    from_bell_diagonal();
+    const double u = rng.uniform();
+    if (backend_ == STABILIZER)
+        return tableau_.measure(target, u);
+
+    flush();
+    if (backend_ == DENSITY)
+        return kernels::measure_density(rho_, num_qubits(), {target}, u);
+    return kernels::measure(state_, num_qubits(), target, u);
+}
+
+inline std::vector<idx> QuantumState::measure(const std::vector<idx>& targets, CounterRng& rng) {
+    std::vector<idx> results(targets.size());
+    from_bell_diagonal();
+    if (backend_ == STABILIZER) {
+        // Highest index first so each removal leaves the remaining targets in place
+        std::vector<size_t> order(targets.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return targets[a] > targets[b]; });
+        for (size_t i : order)
+            results[i] = tableau_.measure(targets[i], rng.uniform());
+        return results;
+    }
+
+    flush();
+    const double u = rng.uniform();
+    idx outcome = backend_ == DENSITY ? kernels::measure_density(rho_, num_qubits(), targets, u)
+                                      : kernels::measure(state_, num_qubits(), targets, u);
+    for (size_t j = 0; j < targets.size(); ++j)
+        results[j] = (outcome >> (targets.size() - 1 - j)) & 1;
+    return results;
+}
+
+inline double QuantumState::probability(idx target) const {
+    if (backend_ == BELL_DIAGONAL)
+        return 0.5; // either half of a Bell state is maximally mixed
+    if (backend_ == STABILIZER) {
+        // The outcome is either fixed or a fair coin; measuring copies with
+        // samples on either side of 1/2 tells which
+        StabilizerState low = tableau_, high = tableau_;
+        const idx a = low.measure(target, 0.25), b = high.measure(target, 0.75);
+        return a == b ? static_cast<double>(a) : 0.5;
+    }
+    flush();
+    if (backend_ == DENSITY)
+        return kernels::outcome_probabilities_density(rho_, num_qubits(), {target})[1];
+    return kernels::probability_one(state_, num_qubits(), target);
+}
+
+inline void QuantumState::collapse(idx target, idx outcome, double p) {
+    from_bell_diagonal();
+    if (backend_ == STABILIZER) {
+        tableau_.measure(target, outcome ? 0.75 : 0.25);
+        return;
+    }
+    if (backend_ == DENSITY)
+        kernels::collapse_density(rho_, num_qubits(), {target}, outcome, p);
+    else
+        kernels::collapse(state_, num_qubits(), target, outcome, p);
+}
+
+inline void QuantumState::append(const QuantumState& other) {
+    from_bell_diagonal();
+    flush();
+    other.flush();
+    if (backend_ == STABILIZER && other.backend_ == STABILIZER) {
+        tableau_.append(other.tableau_);
+        return;
+    }
+    const bool other_mixed = other.backend_ == DENSITY ||
+                             (other.backend_ == BELL_DIAGONAL && !other.pair_.is_pure());
+    if (backend_ == DENSITY || other_mixed) {
+        to_density();
+        cmat rho = qpp::kron(get_density_matrix(), other.get_density_matrix());
+        rho_ = Eigen::Map<const ket>(rho.data(), rho.size());
+        return;
+    }
+    to_ket();
+    state_ = kernels::kron(state_, other.get_ket());
+}
 
-    return {result, states[result]};
+inline void QuantumState::trace_out(idx target) {
+    to_density();
+    kernels::trace_out_density(rho_, num_qubits(), target);
 }
 
+inline std::vector<QuantumState::Factor> QuantumState::factorize() {
+    std::vector<Factor> factors;
+    if (backend_ != KET || num_qubits() < 2)
+        return factors;
+    flush();
+
+    auto groups = kernels::correlated_groups(state_, num_qubits());
+    std::vector<idx> remaining(num_qubits()); // original index of each qubit still here
+    std::iota(remaining.begin(), remaining.end(), 0);
+
+    for (size_t g = 0; g + 1 < groups.size(); ++g) {
+        std::vector<idx> targets;
+        for (idx q : groups[g])
+            targets.push_back(std::lower_bound(remaining.begin(), remaining.end(), q) - remaining.begin());
+
+        ket part;
+        if (!kernels::split(state_, remaining.size(), targets, part))
+            continue;
+        for (auto it = targets.rbegin(); it != targets.rend(); ++it)
+            remaining.erase(remaining.begin() + *it);
+        factors.push_back({groups[g], std::move(part)});
+    }
+    return factors;
+}
 
 inline size_t QuantumState::num_qubits() const {
+    if (backend_ == BELL_DIAGONAL)
+        return 2;
+    if (backend_ == STABILIZER)
+        return tableau_.num_qubits();
+    if (backend_ == DENSITY)
+        return static_cast<size_t>(std::log2(rho_.rows())) / 2;
     return static_cast<size_t>(std::log2(state_.rows()));
-}
\ No newline at end of file
+}
+
+inline void QuantumState::to_ket() {
+    if (backend_ != STABILIZER)
+        return;
+    state_ = tableau_.to_ket();
+    tableau_ = StabilizerState();
+    backend_ = KET;
+}
+
+// vec(|ψ⟩⟨ψ|) = ψ* ⊗ ψ in column-major order
+inline void QuantumState::to_density() {
+    flush();
+    if (backend_ == DENSITY)
+        return;
+    if (backend_ == BELL_DIAGONAL) {
+        const cmat rho = pair_.to_density_matrix();
+        rho_ = Eigen::Map<const ket>(rho.data(), rho.size());
+        pair_ = BellDiagonalState();
+        backend_ = DENSITY;
+        return;
+    }
+    to_ket();
+    rho_ = kernels::kron(ket(state_.conjugate()), state_);
+    state_ = ket();
+    backend_ = DENSITY;
+}
+
+inline void QuantumState::from_bell_diagonal() {
+    if (backend_ != BELL_DIAGONAL)
+        return;
+    if (!pair_.is_pure()) {
+        to_density();
+        return;
+    }
+    state_ = get_ket();
+    pair_ = BellDiagonalState();
+    backend_ = KET;
+}
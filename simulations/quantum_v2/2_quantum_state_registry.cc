@@ -1,45 +1,327 @@
 #include "2_quantum_state_registry.h"
 #include "2_qubit.h"
+#include "2_branching_runner.h"
+#include "ns3/enum.h"
+#include "ns3/abort.h"
 #include <algorithm>
 
-QuantumStateRegistry& QuantumStateRegistry::instance() {
-    static QuantumStateRegistry registry;
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED(QuantumStateRegistry);
+
+TypeId QuantumStateRegistry::GetTypeId() {
+    static TypeId tid = TypeId("ns3::QuantumStateRegistry")
+        .SetParent<Object>()
+        .SetGroupName("Quantum")
+        .AddConstructor<QuantumStateRegistry>()
+        .AddAttribute("DiscardPolicy",
+                      "What happens to a qubit whose last handle is dropped while it is entangled",
+                      EnumValue(QuantumStateRegistry::MEASURE),
+                      MakeEnumAccessor<DiscardPolicy>(&QuantumStateRegistry::m_policy),
+                      MakeEnumChecker(QuantumStateRegistry::MEASURE, "Measure",
+                                      QuantumStateRegistry::TRACE_OUT, "TraceOut"));
+    return tid;
+}
+
+QuantumStateRegistry::QuantumStateRegistry()
+    : m_policy(MEASURE), m_rng(CounterRng::automatic()) {}
+
+Ptr<QuantumStateRegistry> QuantumStateRegistry::GetStandalone() {
+    static Ptr<QuantumStateRegistry> registry = CreateObject<QuantumStateRegistry>();
     return registry;
 }
 
-void QuantumStateRegistry::register_qubit(const std::shared_ptr<Qubit>& q) {
-    auto& vec = state_to_qubits_[q->state()];
-    for (const auto& wq : vec) {
-        if (auto sq = wq.lock(); sq == q) {
-            return; // already registered
+void QuantumStateRegistry::SetDiscardPolicy(DiscardPolicy policy) {
+    m_policy = policy;
+}
+
+QuantumStateRegistry::DiscardPolicy QuantumStateRegistry::GetDiscardPolicy() const {
+    return m_policy;
+}
+
+int64_t QuantumStateRegistry::AssignStreams(int64_t stream) {
+    m_rng = CounterRng::from_seed_manager(stream);
+    return 1;
+}
+
+QubitHandle QuantumStateRegistry::Acquire(Qubit* q, std::shared_ptr<QuantumState> state, size_t index) {
+    uint32_t slot;
+    if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+    slots_[slot].qubit = q;
+    AttachSlot(slot, std::move(state), index);
+    return {slot, slots_[slot].generation};
+}
+
+void QuantumStateRegistry::Release(QubitHandle h) {
+    const uint32_t slot = SlotOf(h);
+    slots_[slot].qubit = nullptr;
+    const uint32_t root = Find(slot);
+    if (Collect(root))
+        return;
+
+    auto state = slots_[root].state;
+    // Tracing out needs no factorization on a density matrix, which is what a
+    // Bell-diagonal pair turns into
+    const bool mixed = state->backend() == QuantumState::DENSITY || state->backend() == QuantumState::BELL_DIAGONAL;
+    if (m_policy == MEASURE || mixed) {
+        const size_t index = IndexOfSlot(slot);
+        if (m_policy != MEASURE) {
+            state->trace_out(index);
+        } else if (BranchingRunner::active()) {
+            const double p1 = state->probability(index);
+            const size_t result = BranchingRunner::branch({1.0 - p1, p1});
+            state->collapse(index, result, result ? p1 : 1.0 - p1);
+        } else {
+            state->measure(index, m_rng);
         }
+        DetachSlots({slot});
+        Collect(slot);
+    } else {
+        Factorize(state);
+    }
+}
+
+bool QuantumStateRegistry::IsValid(QubitHandle h) const {
+    return h.slot < slots_.size() && slots_[h.slot].generation == h.generation && slots_[h.slot].parent != npos;
+}
+
+std::shared_ptr<Qubit> QuantumStateRegistry::GetQubit(QubitHandle h) const {
+    if (!IsValid(h) || !slots_[h.slot].qubit)
+        return nullptr;
+    return slots_[h.slot].qubit->shared_from_this();
+}
+
+const std::shared_ptr<QuantumState>& QuantumStateRegistry::StateOf(QubitHandle h) {
+    return slots_[Find(SlotOf(h))].state;
+}
+
+size_t QuantumStateRegistry::IndexOf(QubitHandle h) {
+    return IndexOfSlot(SlotOf(h));
+}
+
+size_t QuantumStateRegistry::IndexOfSlot(uint32_t slot) {
+    uint32_t root = Find(slot);
+    int64_t index = slots_[root].offset;
+    if (slot != root)
+        index += slots_[slot].offset;
+    return static_cast<size_t>(index);
+}
+
+void QuantumStateRegistry::Merge(QubitHandle a, QubitHandle b) {
+    uint32_t ra = Find(SlotOf(a)), rb = Find(SlotOf(b));
+    if (ra == rb)
+        return;
+    if (slots_[ra].size < slots_[rb].size)
+        std::swap(ra, rb);
+
+    Slot& big = slots_[ra];
+    Slot& small = slots_[rb];
+    const int64_t shift = static_cast<int64_t>(big.state->num_qubits());
+    big.state->append(*small.state);
+    state_roots_.erase(small.state.get());
+    small.state.reset();
+
+    small.offset += shift - big.offset;
+    small.parent = ra;
+    big.size += small.size;
+    std::swap(big.next, small.next);
+}
+
+void QuantumStateRegistry::Adopt(Ptr<QuantumStateRegistry> other, QubitHandle h) {
+    const uint32_t root = other->Find(other->SlotOf(h));
+    auto state = other->slots_[root].state;
+    for (uint32_t m : other->Members(root)) {
+        Qubit* q = other->slots_[m].qubit;
+        QubitHandle adopted = Acquire(q, state, other->IndexOfSlot(m));
+        if (q)
+            q->Rebind(this, adopted);
+    }
+    other->FreeGroup(root);
+}
+
+void QuantumStateRegistry::Detach(const std::vector<QubitHandle>& handles) {
+    std::vector<uint32_t> slots;
+    for (QubitHandle h : handles)
+        slots.push_back(SlotOf(h));
+    DetachSlots(slots);
+}
+
+void QuantumStateRegistry::DetachSlots(const std::vector<uint32_t>& slots) {
+    if (slots.empty())
+        return;
+    const uint32_t old_root = Find(slots[0]);
+    auto state = slots_[old_root].state;
+
+    std::vector<size_t> removed;
+    for (uint32_t s : slots)
+        removed.push_back(IndexOfSlot(s));
+    std::sort(removed.begin(), removed.end());
+
+    std::vector<std::pair<uint32_t, size_t>> remaining;
+    for (uint32_t m : Members(old_root)) {
+        if (std::find(slots.begin(), slots.end(), m) != slots.end())
+            continue;
+        size_t index = IndexOfSlot(m);
+        size_t below = std::lower_bound(removed.begin(), removed.end(), index) - removed.begin();
+        remaining.push_back({m, index - below});
+    }
+
+    for (uint32_t s : slots) {
+        slots_[s].parent = s;
+        slots_[s].offset = 0;
+        slots_[s].next = s;
+        slots_[s].size = 1;
+        slots_[s].state.reset();
+    }
+    slots_[old_root].state.reset();
+
+    if (remaining.empty()) {
+        state_roots_.erase(state.get());
+        return;
+    }
+
+    const auto [root, root_index] = remaining[0];
+    for (size_t i = 0; i < remaining.size(); ++i) {
+        const auto [m, index] = remaining[i];
+        slots_[m].parent = root;
+        slots_[m].offset = static_cast<int64_t>(index) - (m == root ? 0 : static_cast<int64_t>(root_index));
+        slots_[m].next = remaining[(i + 1) % remaining.size()].first;
+    }
+    slots_[root].size = static_cast<uint32_t>(remaining.size());
+    slots_[root].state = state;
+    state_roots_[state.get()] = root;
+    Collect(root);
+}
+
+void QuantumStateRegistry::Attach(QubitHandle h, std::shared_ptr<QuantumState> state, size_t index) {
+    AttachSlot(SlotOf(h), std::move(state), index);
+}
+
+void QuantumStateRegistry::AttachSlot(uint32_t slot, std::shared_ptr<QuantumState> state, size_t index) {
+    auto it = state_roots_.find(state.get());
+    if (it == state_roots_.end()) {
+        MakeRoot(slot, std::move(state), index);
+        return;
     }
 
-    vec.push_back(q);
+    Slot& root = slots_[it->second];
+    Slot& s = slots_[slot];
+    s.parent = it->second;
+    s.offset = static_cast<int64_t>(index) - root.offset;
+    s.next = root.next;
+    root.next = slot;
+    root.size++;
 }
 
+void QuantumStateRegistry::Factorize(const std::shared_ptr<QuantumState>& state) {
+    auto it = state_roots_.find(state.get());
+    if (it == state_roots_.end())
+        return;
 
+    std::vector<uint32_t> slot_at(state->num_qubits());
+    for (uint32_t m : Members(it->second))
+        slot_at[IndexOfSlot(m)] = m;
 
-void QuantumStateRegistry::unregister_qubit(const std::shared_ptr<Qubit>& q) {
-    auto& vec = state_to_qubits_[q->state()];
-    vec.erase(std::remove_if(vec.begin(), vec.end(),
-        [&](const std::weak_ptr<Qubit>& wq) {
-            auto sq = wq.lock();
-            return !sq || sq == q;
-        }), vec.end());
+    auto factors = state->factorize();
+    if (factors.empty())
+        return;
 
-    if (vec.empty())
-        state_to_qubits_.erase(q->state());
+    std::vector<uint32_t> moved;
+    for (const auto& f : factors)
+        for (qpp::idx q : f.qubits)
+            moved.push_back(slot_at[q]);
+    DetachSlots(moved);
+
+    for (auto& f : factors) {
+        auto part = std::make_shared<QuantumState>(std::move(f.state));
+        for (size_t j = 0; j < f.qubits.size(); ++j)
+            AttachSlot(slot_at[f.qubits[j]], part, j);
+        Collect(Find(slot_at[f.qubits[0]]));
+    }
 }
 
-std::vector<std::shared_ptr<Qubit>> QuantumStateRegistry::get_qubits(std::shared_ptr<QuantumState> state) {
+std::vector<std::shared_ptr<Qubit>> QuantumStateRegistry::GetQubits(std::shared_ptr<QuantumState> state) {
     std::vector<std::shared_ptr<Qubit>> result;
-    auto it = state_to_qubits_.find(state);
-    if (it != state_to_qubits_.end()) {
-        for (auto& wq : it->second) {
-            if (auto sq = wq.lock())
-                result.push_back(sq);
+    auto it = state_roots_.find(state.get());
+    if (it != state_roots_.end()) {
+        for (uint32_t m : Members(it->second)) {
+            if (slots_[m].qubit)
+                result.push_back(slots_[m].qubit->shared_from_this());
         }
     }
     return result;
 }
+
+uint32_t QuantumStateRegistry::SlotOf(QubitHandle h) const {
+    NS_ABORT_MSG_IF(!IsValid(h), "stale qubit handle");
+    return h.slot;
+}
+
+uint32_t QuantumStateRegistry::Find(uint32_t slot) {
+    uint32_t root = slot;
+    int64_t rel = 0; // slot's index relative to the root's
+    while (slots_[root].parent != root) {
+        rel += slots_[root].offset;
+        root = slots_[root].parent;
+    }
+
+    // Path compression: point every node on the path straight at the root
+    uint32_t s = slot;
+    while (s != root && slots_[s].parent != root) {
+        uint32_t parent = slots_[s].parent;
+        int64_t offset = slots_[s].offset;
+        slots_[s].parent = root;
+        slots_[s].offset = rel;
+        rel -= offset;
+        s = parent;
+    }
+    return root;
+}
+
+std::vector<uint32_t> QuantumStateRegistry::Members(uint32_t root) const {
+    std::vector<uint32_t> result;
+    uint32_t s = root;
+    do {
+        result.push_back(s);
+        s = slots_[s].next;
+    } while (s != root);
+    return result;
+}
+
+void QuantumStateRegistry::MakeRoot(uint32_t slot, std::shared_ptr<QuantumState> state, size_t index) {
+    Slot& s = slots_[slot];
+    s.parent = slot;
+    s.offset = static_cast<int64_t>(index);
+    s.next = slot;
+    s.size = 1;
+    state_roots_[state.get()] = slot;
+    s.state = std::move(state);
+}
+
+bool QuantumStateRegistry::Collect(uint32_t root) {
+    for (uint32_t m : Members(root))
+        if (slots_[m].qubit)
+            return false;
+
+    FreeGroup(root);
+    return true;
+}
+
+void QuantumStateRegistry::FreeGroup(uint32_t root) {
+    if (slots_[root].state)
+        state_roots_.erase(slots_[root].state.get());
+    for (uint32_t m : Members(root)) {
+        const uint32_t generation = slots_[m].generation + 1;
+        slots_[m] = Slot{};
+        slots_[m].generation = generation;
+        free_.push_back(m);
+    }
+}
+
+}
@@ -1,20 +1,124 @@
 #pragma once
+#include "ns3/object.h"
+#include "ns3/ptr.h"
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <cstdint>
 #include "2_quantum_state.h"
 
 class Qubit;
 
-class QuantumStateRegistry {
+namespace ns3 {
+
+// Compact reference to a registry slot. The generation changes every time
+// the slot is freed, so a stale handle is caught instead of aliasing the
+// slot's next occupant.
+struct QubitHandle {
+    uint32_t slot;
+    uint32_t generation;
+};
+
+// Tracks which qubits share a QuantumState as a disjoint-set forest over
+// integer slots, one slot per qubit, kept in a slab that recycles freed
+// slots. Each root owns the group's state; a
+// qubit's index into that state is the sum of offsets along its path to the
+// root, so merging two groups only re-parents the smaller root (union by
+// size) and Find() keeps paths short (path compression). Members of a group
+// are also kept on a circular list so they can be enumerated.
+//
+// One registry per simulation: qubits keep a reference to the registry
+// that holds their slot, so independent simulations in one process never
+// share state.
+class QuantumStateRegistry : public Object {
 public:
-    static QuantumStateRegistry& instance();
+    static TypeId GetTypeId();
+
+    // What happens to the amplitudes of a qubit whose handle is destroyed
+    // while it is still part of a larger state. MEASURE collapses it and
+    // drops the outcome, which leaves the other qubits with the same reduced
+    // state as tracing it out. TRACE_OUT takes the partial trace of a density
+    // matrix right away; from a ket it removes the qubit only once it factors
+    // out of the state, and until then it stays behind as a ghost slot.
+    enum DiscardPolicy { MEASURE, TRACE_OUT };
+
+    QuantumStateRegistry();
+
+    // Registry for qubits made without a component (Qubit's default
+    // constructor), shared by all of them
+    static Ptr<QuantumStateRegistry> GetStandalone();
+
+    void SetDiscardPolicy(DiscardPolicy policy);
+    DiscardPolicy GetDiscardPolicy() const;
+
+    // Fixes the stream used to measure discarded qubits; returns the number
+    // of streams used (1)
+    int64_t AssignStreams(int64_t stream);
+
+    // Allocates a slot for q, which holds index within state
+    QubitHandle Acquire(Qubit* q, std::shared_ptr<QuantumState> state, size_t index);
+    // The qubit handle is gone; its amplitudes are discarded per the policy
+    void Release(QubitHandle h);
 
-    void register_qubit(const std::shared_ptr<Qubit>& q);
-    void unregister_qubit(const std::shared_ptr<Qubit>& q);
+    bool IsValid(QubitHandle h) const;
+    // The Qubit object for h, or null once it has been destroyed
+    std::shared_ptr<Qubit> GetQubit(QubitHandle h) const;
 
-    std::vector<std::shared_ptr<Qubit>> get_qubits(std::shared_ptr<QuantumState> state);
+    // Valid until the registry next changes
+    const std::shared_ptr<QuantumState>& StateOf(QubitHandle h);
+    size_t IndexOf(QubitHandle h);
+
+    // Joins the groups of a and b, tensoring the smaller group's state onto
+    // the larger one. No-op if they already share a state.
+    void Merge(QubitHandle a, QubitHandle b);
+    // Moves the whole group of slot out of other and into this registry,
+    // rebinding its qubits, so it can be merged with groups held here
+    void Adopt(Ptr<QuantumStateRegistry> other, QubitHandle h);
+
+    // Removes slots, which must share a group and whose qubits have already
+    // been taken out of its state, and shifts the remaining indices down.
+    // Detached slots are left without a state until Attach() is called; a
+    // remainder made only of discarded qubits is freed.
+    void Detach(const std::vector<QubitHandle>& handles);
+    // Places a detached slot at index within state
+    void Attach(QubitHandle h, std::shared_ptr<QuantumState> state, size_t index);
+
+    // Splits state into independent states wherever it is a product (see
+    // QuantumState::factorize) and moves the affected slots along. Factors
+    // that only hold discarded qubits are dropped.
+    void Factorize(const std::shared_ptr<QuantumState>& state);
+
+    std::vector<std::shared_ptr<Qubit>> GetQubits(std::shared_ptr<QuantumState> state);
 
 private:
-    std::unordered_map<std::shared_ptr<QuantumState>, std::vector<std::weak_ptr<Qubit>>> state_to_qubits_;
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    struct Slot {
+        Qubit* qubit = nullptr;
+        uint32_t parent = npos;
+        int64_t offset = 0;   // index relative to the parent's (the root's own index at a root)
+        uint32_t next = npos; // circular member list
+        uint32_t size = 0;    // group size, valid at roots
+        uint32_t generation = 0;
+        std::shared_ptr<QuantumState> state; // valid at roots
+    };
+
+    uint32_t SlotOf(QubitHandle h) const;
+    size_t IndexOfSlot(uint32_t slot);
+    void DetachSlots(const std::vector<uint32_t>& slots);
+    void AttachSlot(uint32_t slot, std::shared_ptr<QuantumState> state, size_t index);
+    uint32_t Find(uint32_t slot);
+    std::vector<uint32_t> Members(uint32_t root) const;
+    void MakeRoot(uint32_t slot, std::shared_ptr<QuantumState> state, size_t index);
+    // Frees the group of root if none of its qubits has a live handle
+    bool Collect(uint32_t root);
+    void FreeGroup(uint32_t root);
+
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> free_;
+    std::unordered_map<const QuantumState*, uint32_t> state_roots_;
+    DiscardPolicy m_policy;
+    CounterRng m_rng;
 };
+
+}
@@ -1,43 +1,79 @@
 #pragma once
+#include "ns3/object.h"
 #include "2_quantum_state.h"
 #include "2_quantum_state_registry.h"
+#include "2_qubit_id.h"
+#include "2_qubit_store.h"
+#include "2_slab_allocator.h"
 #include <memory>
 #include <string>
 
+// Thin shared_ptr-compatible wrapper around a registry handle. All the
+// qubit's bookkeeping lives in its registry slot; the object itself is just
+// the registry reference, the generational handle, an interned ID and its
+// position in the QubitStore holding it (48 bytes on 64-bit targets).
+// Create() allocates it together with its control block from a slab.
 class Qubit : public std::enable_shared_from_this<Qubit> {
 public:
-    // Default constructor: qubit in |0⟩
+    // Default constructor: qubit in |0⟩, in the standalone registry
     Qubit(const std::string& id = "")
-        : id_(id), index_(0), state_(std::make_shared<QuantumState>(1)) {}
+        : Qubit(ns3::QuantumStateRegistry::GetStandalone(), 0, std::make_shared<QuantumState>(1), id) {}
 
+    // Qubit at index within state, tracked by registry
+    Qubit(ns3::Ptr<ns3::QuantumStateRegistry> registry, size_t index, std::shared_ptr<QuantumState> state,
+          QubitId id = QubitId())
+        : id_(id), registry_(registry), handle_(registry->Acquire(this, std::move(state), index)) {}
 
+    ~Qubit() { registry_->Release(handle_); }
 
-    // Constructor for manually assigned index/state
-    Qubit(size_t index, std::shared_ptr<QuantumState> state, const std::string& id = "")
-        : id_(id), index_(index), state_(std::move(state)) {}
+    Qubit(const Qubit&) = delete;
+    Qubit& operator=(const Qubit&) = delete;
 
-        
-    size_t index() const;
-    void set_index(size_t index) { index_ = index; }
+    static std::shared_ptr<Qubit> Create(ns3::Ptr<ns3::QuantumStateRegistry> registry, size_t index,
+                                         std::shared_ptr<QuantumState> state, QubitId id = QubitId());
 
-    QuantumState::Ptr state() const;
-    void set_state(std::shared_ptr<QuantumState> new_state);
+    // Where the qubit currently lives is owned by the registry: merges and
+    // measurements move it between states without touching the handle.
+    // The reference is only good until the registry next changes; copy it
+    // to keep the state across a merge, measurement or transfer.
+    size_t index() const;
+    const QuantumState::Ptr& state() const;
+    ns3::Ptr<ns3::QuantumStateRegistry> registry() const { return registry_; }
+    ns3::QubitHandle handle() const { return handle_; }
 
-    std::string get_id() const { return id_; }
-    void set_id(const std::string& id) { id_ = id; }
+    QubitId id() const { return id_; }
+    std::string get_id() const { return id_.str(); }
+    void set_id(const std::string& id);
 
 private:
-    std::string id_;
-    size_t index_;
-    QuantumState::Ptr state_;
+    friend class ns3::QuantumStateRegistry;
+    friend class QubitStore;
+    void Rebind(ns3::Ptr<ns3::QuantumStateRegistry> registry, ns3::QubitHandle handle);
+
+    QubitId id_;
+    uint32_t store_pos_ = 0; // next to id_, which leaves no padding
+    ns3::Ptr<ns3::QuantumStateRegistry> registry_;
+    ns3::QubitHandle handle_;
+    QubitStore* store_ = nullptr; // store holding this qubit, if any
 };
 
 // ----------- Inline implementations ------------
-inline size_t Qubit::index() const { return index_; }
-inline QuantumState::Ptr Qubit::state() const { return state_; }
-
-inline void Qubit::set_state(std::shared_ptr<QuantumState> new_state) {
-    QuantumStateRegistry::instance().unregister_qubit(shared_from_this());
-    state_ = std::move(new_state);
-    QuantumStateRegistry::instance().register_qubit(shared_from_this());
-}
\ No newline at end of file
+inline std::shared_ptr<Qubit> Qubit::Create(ns3::Ptr<ns3::QuantumStateRegistry> registry, size_t index,
+                                            std::shared_ptr<QuantumState> state, QubitId id) {
+    return std::allocate_shared<Qubit>(SlabAllocator<Qubit>(), std::move(registry), index, std::move(state), id);
+}
+
+inline size_t Qubit::index() const { return registry_->IndexOf(handle_); }
+inline const QuantumState::Ptr& Qubit::state() const { return registry_->StateOf(handle_); }
+
+inline void Qubit::set_id(const std::string& id) {
+    const QubitId old_id = id_;
+    id_ = QubitId(id);
+    if (store_)
+        store_->rekey(*this, old_id);
+}
+
+inline void Qubit::Rebind(ns3::Ptr<ns3::QuantumStateRegistry> registry, ns3::QubitHandle handle) {
+    registry_ = registry;
+    handle_ = handle;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interned qubit ID. Each distinct string is stored once in a process-wide
+// table; IDs are a 32-bit index into it, so copying, comparing and hashing
+// them never touches the string. Index 0 is the empty ID.
+//
+// The table is never freed and never shrinks: it holds every name ever
+// interned in the process, across simulation runs. Give qubits a fixed set
+// of names (roles such as "teleport_target", not per-attempt or per-round
+// names) and it stays small; generated traffic such as heralded pairs and
+// trains carries no names at all. It takes no lock, so IDs must only be
+// created on the simulation thread (the state kernels' thread pool never
+// does; replicas and branches are separate processes with their own copy).
+class QubitId {
+public:
+    QubitId() : index_(0) {}
+    QubitId(const std::string& id) : index_(intern(id)) {}
+    QubitId(const char* id) : index_(intern(id)) {}
+
+    // The ID of a name already interned, without adding it to the table;
+    // empty if no qubit was ever given that name
+    static std::optional<QubitId> lookup(const std::string& id);
+
+    const std::string& str() const { return strings()[index_]; }
+    uint32_t index() const { return index_; }
+    bool empty() const { return index_ == 0; }
+
+    bool operator==(const QubitId& other) const { return index_ == other.index_; }
+    bool operator!=(const QubitId& other) const { return index_ != other.index_; }
+
+private:
+    explicit QubitId(uint32_t index) : index_(index) {}
+
+    static std::deque<std::string>& strings();
+    static std::unordered_map<std::string_view, uint32_t>& indices();
+    static uint32_t intern(std::string_view id);
+
+    uint32_t index_;
+};
+
+template <>
+struct std::hash<QubitId> {
+    size_t operator()(const QubitId& id) const noexcept { return id.index(); }
+};
+
+
+// ----------- Inline implementations ------------
+inline std::deque<std::string>& QubitId::strings() {
+    // A deque never moves its elements, so the views keyed below stay valid
+    static std::deque<std::string> table{std::string()};
+    return table;
+}
+
+inline std::unordered_map<std::string_view, uint32_t>& QubitId::indices() {
+    static std::unordered_map<std::string_view, uint32_t> index{{strings()[0], 0}};
+    return index;
+}
+
+inline uint32_t QubitId::intern(std::string_view id) {
+    auto& index = indices();
+    auto it = index.find(id);
+    if (it != index.end())
+        return it->second;
+
+    auto& table = strings();
+    table.emplace_back(id);
+    const uint32_t i = static_cast<uint32_t>(table.size() - 1);
+    index.emplace(table.back(), i);
+    return i;
+}
+
+inline std::optional<QubitId> QubitId::lookup(const std::string& id) {
+    const auto& index = indices();
+    auto it = index.find(id);
+    if (it == index.end())
+        return std::nullopt;
+    return QubitId(it->second);
+}
@@ -0,0 +1,63 @@
+#include "2_qubit_store.h"
+#include "2_qubit.h"
+
+QubitStore::~QubitStore() {
+    for (const auto& q : qubits_)
+        q->store_ = nullptr;
+}
+
+void QubitStore::insert(std::shared_ptr<Qubit> q) {
+    if (q->store_ == this)
+        return;
+    if (q->store_)
+        q->store_->erase(q);
+
+    q->store_ = this;
+    q->store_pos_ = static_cast<uint32_t>(qubits_.size());
+    if (!q->id_.empty())
+        by_id_.emplace(q->id_, q.get());
+    qubits_.push_back(std::move(q));
+}
+
+bool QubitStore::erase(const std::shared_ptr<Qubit>& q) {
+    if (!contains(*q))
+        return false;
+
+    const uint32_t pos = q->store_pos_;
+    unindex(*q, q->id_);
+    q->store_ = nullptr;
+
+    if (pos + 1 != qubits_.size()) {
+        qubits_[pos] = std::move(qubits_.back());
+        qubits_[pos]->store_pos_ = pos;
+    }
+    qubits_.pop_back();
+    return true;
+}
+
+std::shared_ptr<Qubit> QubitStore::find(QubitId id) const {
+    auto it = by_id_.find(id);
+    if (it == by_id_.end())
+        return nullptr;
+    return qubits_[it->second->store_pos_];
+}
+
+bool QubitStore::contains(const Qubit& q) const {
+    return q.store_ == this;
+}
+
+void QubitStore::rekey(Qubit& q, QubitId old_id) {
+    unindex(q, old_id);
+    if (!q.id_.empty())
+        by_id_.emplace(q.id_, &q);
+}
+
+void QubitStore::unindex(Qubit& q, QubitId id) {
+    auto [first, last] = by_id_.equal_range(id);
+    for (auto it = first; it != last; ++it) {
+        if (it->second == &q) {
+            by_id_.erase(it);
+            return;
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "2_qubit_id.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Qubit;
+
+// Qubits held by one component. Qubits sit in a dense vector and remember
+// their own position in it, so removal swaps the last one into the hole in
+// O(1); an index on interned IDs makes lookup by ID O(1) as well. A stored
+// qubit reports ID changes back through rekey(), and a qubit lives in at
+// most one store: inserting it elsewhere takes it out of its current one.
+class QubitStore {
+public:
+    using const_iterator = std::vector<std::shared_ptr<Qubit>>::const_iterator;
+
+    QubitStore() = default;
+    ~QubitStore();
+
+    QubitStore(const QubitStore&) = delete;
+    QubitStore& operator=(const QubitStore&) = delete;
+
+    void insert(std::shared_ptr<Qubit> q);
+    // Returns false if q is not in this store
+    bool erase(const std::shared_ptr<Qubit>& q);
+    // Any stored qubit with this ID, or null
+    std::shared_ptr<Qubit> find(QubitId id) const;
+    bool contains(const Qubit& q) const;
+
+    size_t size() const { return qubits_.size(); }
+    const_iterator begin() const { return qubits_.begin(); }
+    const_iterator end() const { return qubits_.end(); }
+
+    // Called by a stored qubit after its ID changed from old_id
+    void rekey(Qubit& q, QubitId old_id);
+
+private:
+    void unindex(Qubit& q, QubitId id);
+
+    std::vector<std::shared_ptr<Qubit>> qubits_;
+    std::unordered_multimap<QubitId, Qubit*> by_id_;
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include "ns3/nstime.h"
+#include "2_qubit.h"
+#include <memory>
+#include <vector>
+
+namespace ns3 {
+
+// Qubits sent back to back, e.g. the photons of one source burst, each with
+// its emission time relative to the send. Offsets are non-decreasing and
+// there is one per qubit. A channel carries the whole train as one event;
+// on delivery the offsets are arrival times relative to that event.
+struct QubitTrain {
+    std::vector<std::shared_ptr<Qubit>> qubits;
+    std::vector<Time> offsets;
+};
+
+}
@@ -0,0 +1,175 @@
+#include "2_repeater_chain.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/enum.h"
+#include "ns3/pointer.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED(RepeaterChain);
+
+TypeId RepeaterChain::GetTypeId() {
+    static TypeId tid = TypeId("ns3::RepeaterChain")
+        .SetParent<Object>()
+        .SetGroupName("Quantum")
+        .AddConstructor<RepeaterChain>()
+        .AddAttribute("LinkDelay",
+                      "Propagation delay of every link, also used per hop for heralds",
+                      TimeValue(MicroSeconds(10)),
+                      MakeTimeAccessor(&RepeaterChain::m_delay),
+                      MakeTimeChecker())
+        .AddAttribute("Rounds",
+                      "Number of end-to-end pairs to distribute",
+                      UintegerValue(1),
+                      MakeUintegerAccessor(&RepeaterChain::m_rounds),
+                      MakeUintegerChecker<uint32_t>())
+        .AddAttribute("LinkErrorModel",
+                      "Noise applied to every half sent over a link",
+                      PointerValue(),
+                      MakePointerAccessor(&RepeaterChain::m_linkErrorModel),
+                      MakePointerChecker<QuantumErrorModel>());
+    return tid;
+}
+
+RepeaterChain::RepeaterChain()
+    : m_delay(MicroSeconds(10)), m_rounds(1),
+      m_registry(CreateObject<QuantumStateRegistry>()),
+      m_generating(false), m_heard(0), m_done(0), m_x(0), m_z(0) {}
+
+void RepeaterChain::Install(const NodeContainer& nodes) {
+    NS_ABORT_MSG_IF(nodes.GetN() < 2, "a repeater chain needs at least two nodes");
+
+    for (uint32_t i = 0; i < nodes.GetN(); ++i) {
+        Ptr<QuantumComponent> component = nodes.Get(i)->GetObject<QuantumComponent>();
+        if (!component) {
+            component = CreateObject<QuantumComponent>();
+            component->SetAttribute("Backend", EnumValue(QuantumState::BELL_DIAGONAL));
+            component->SetAttribute("Registry", PointerValue(m_registry));
+            nodes.Get(i)->AggregateObject(component);
+        }
+        component->SetReceiveCallback([this, i](std::shared_ptr<Qubit> q) { Arrive(i, q); });
+        m_components.push_back(component);
+    }
+
+    for (uint32_t i = 0; i + 1 < m_components.size(); ++i) {
+        Ptr<QuantumNetDevice> tx = CreateObject<QuantumNetDevice>();
+        Ptr<QuantumNetDevice> rx = CreateObject<QuantumNetDevice>();
+        m_components[i]->AddDevice(tx);
+        m_components[i + 1]->AddDevice(rx);
+        Ptr<QuantumChannel> channel = CreateObject<QuantumChannel>();
+        channel->SetDelay(m_delay);
+        if (m_linkErrorModel)
+            channel->SetErrorModel(m_linkErrorModel);
+        channel->Connect(m_components[i], m_components[i + 1]);
+        tx->Attach(channel);
+        rx->Attach(channel);
+        tx->SetWakeCallback([this, i] { Resend(i); });
+        m_devices.push_back(tx);
+        m_channels.push_back(channel);
+    }
+    m_right.resize(m_components.size());
+    m_refused.resize(m_components.size());
+}
+
+void RepeaterChain::Start() {
+    Simulator::ScheduleNow(&RepeaterChain::Round, this);
+}
+
+void RepeaterChain::SetDeliveryCallback(DeliveryCallback cb) {
+    m_deliver = std::move(cb);
+}
+
+int64_t RepeaterChain::AssignStreams(int64_t stream) {
+    int64_t used = m_registry->AssignStreams(stream);
+    for (const auto& component : m_components)
+        used += component->AssignStreams(stream + used);
+    for (const auto& channel : m_channels)
+        used += channel->AssignStreams(stream + used);
+    // Each channel re-seeds the error model they share; give it a stream of
+    // its own last
+    if (m_linkErrorModel)
+        used += m_linkErrorModel->AssignStreams(stream + used);
+    return used;
+}
+
+uint32_t RepeaterChain::GetNNodes() const {
+    return static_cast<uint32_t>(m_components.size());
+}
+
+Ptr<QuantumComponent> RepeaterChain::GetComponent(uint32_t i) const {
+    return m_components[i];
+}
+
+Ptr<QuantumChannel> RepeaterChain::GetChannel(uint32_t i) const {
+    return m_channels[i];
+}
+
+void RepeaterChain::Round() {
+    m_heard = 0;
+    m_x = m_z = 0;
+    m_generating = true;
+    for (uint32_t i = 0; i < m_devices.size(); ++i) {
+        auto [kept, sent] = m_components[i]->CreateEntangledPair();
+        m_right[i] = kept;
+        if (!m_devices[i]->SendQubit(sent))
+            m_refused[i] = sent;
+    }
+    m_generating = false;
+}
+
+// A half the device's queue had no room for stays at node i until the
+// device wakes
+void RepeaterChain::Resend(uint32_t i) {
+    if (m_refused[i] && m_devices[i]->SendQubit(m_refused[i]))
+        m_refused[i].reset();
+}
+
+void RepeaterChain::Arrive(uint32_t node, std::shared_ptr<Qubit> q) {
+    // CreateEntangledPair stores both halves through the same callback
+    if (m_generating)
+        return;
+
+    const uint32_t last = GetNNodes() - 1;
+    if (node == last) {
+        m_end = q;
+        if (m_heard == last - 1)
+            Deliver();
+        return;
+    }
+
+    Ptr<QuantumComponent> c = m_components[node];
+    auto m = c->SwapEntanglement(q, m_right[node]);
+    c->RemoveQubit(q);
+    c->RemoveQubit(m_right[node]);
+    m_right[node].reset();
+    Simulator::Schedule(m_delay * static_cast<int64_t>(last - node), &RepeaterChain::Herald, this, m[1], m[0]);
+}
+
+void RepeaterChain::Herald(qpp::idx x, qpp::idx z) {
+    m_x ^= x;
+    m_z ^= z;
+    if (++m_heard == GetNNodes() - 2 && m_end)
+        Deliver();
+}
+
+void RepeaterChain::Deliver() {
+    Ptr<QuantumComponent> first = m_components.front();
+    Ptr<QuantumComponent> last = m_components.back();
+    if (m_x)
+        last->ApplyGate(Gate::X, m_end);
+    if (m_z)
+        last->ApplyGate(Gate::Z, m_end);
+    if (m_deliver)
+        m_deliver(m_right.front(), m_end);
+
+    first->RemoveQubit(m_right.front());
+    last->RemoveQubit(m_end);
+    m_right.front().reset();
+    m_end.reset();
+    if (++m_done < m_rounds)
+        Simulator::ScheduleNow(&RepeaterChain::Round, this);
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "ns3/object.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "2_qubit.h"
+#include "2_quantum_component.h"
+#include "2_quantum_channel.h"
+#include "2_quantum_net_device.h"
+#include "2_quantum_error_model.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ns3 {
+
+// Entanglement distribution along a line of nodes. Every round each node
+// but the last creates a Bell pair and sends one half to its right-hand
+// neighbour over a QuantumNetDevice/QuantumChannel link. An inner node
+// swaps (QuantumComponent::SwapEntanglement) as soon as the half from its
+// left arrives, and heralds the outcome to the last node, which applies
+// the accumulated Pauli correction once the last swap has been heard from.
+// The two end qubits are then handed to the delivery callback.
+//
+// Nodes are given the BellDiagonal backend, so every swap is a closed-form
+// update of one pair and a round costs O(nodes) whatever the chain length.
+// Heralds are modelled as events delayed by the link delay per hop; there
+// is no classical network underneath. Links are assumed lossless: a lost
+// half stalls the round. A half whose device refuses it (a full transmit
+// queue) is sent again once the device wakes.
+class RepeaterChain : public Object {
+public:
+    static TypeId GetTypeId();
+
+    // Called with the end-to-end pair (first node's qubit, last node's
+    // qubit) after correction; the chain drops both once it returns
+    using DeliveryCallback = std::function<void(std::shared_ptr<Qubit>, std::shared_ptr<Qubit>)>;
+
+    RepeaterChain();
+
+    // Aggregates a QuantumComponent onto every node that lacks one, all
+    // sharing one registry, and links each node to the next
+    void Install(const NodeContainer& nodes);
+    // Runs Rounds rounds back to back, the first one now
+    void Start();
+
+    void SetDeliveryCallback(DeliveryCallback cb);
+
+    // Fixes the streams of the shared registry, every component and channel,
+    // then the link error model; returns the number of streams used
+    int64_t AssignStreams(int64_t stream);
+
+    uint32_t GetNNodes() const;
+    Ptr<QuantumComponent> GetComponent(uint32_t i) const;
+    // Link from node i to node i + 1
+    Ptr<QuantumChannel> GetChannel(uint32_t i) const;
+
+private:
+    void Round();
+    void Resend(uint32_t i);
+    void Arrive(uint32_t node, std::shared_ptr<Qubit> q);
+    void Herald(qpp::idx x, qpp::idx z);
+    void Deliver();
+
+    Time m_delay;
+    uint32_t m_rounds;
+    Ptr<QuantumErrorModel> m_linkErrorModel;
+    DeliveryCallback m_deliver;
+
+    Ptr<QuantumStateRegistry> m_registry;
+    std::vector<Ptr<QuantumComponent>> m_components;
+    std::vector<Ptr<QuantumNetDevice>> m_devices; // node i's device towards i + 1
+    std::vector<Ptr<QuantumChannel>> m_channels;
+
+    std::vector<std::shared_ptr<Qubit>> m_right;   // half kept by node i for the link to i + 1
+    std::vector<std::shared_ptr<Qubit>> m_refused; // half node i's device had no room for
+    std::shared_ptr<Qubit> m_end;                  // half received by the last node
+    bool m_generating;                             // pairs being created, not received
+    uint32_t m_heard;
+    uint32_t m_done;
+    qpp::idx m_x, m_z;
+};
+
+}
@@ -0,0 +1,235 @@
+#include "2_replica_runner.h"
+#include "ns3/abort.h"
+#include "ns3/object.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+#include "qpp/qpp.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// Replicas are summarized in fixed blocks that are merged in block order,
+// so the floating-point result does not depend on the worker count
+constexpr uint64_t kBlockSize = 64;
+
+// Running mean and sum of squared deviations (Welford), plus the range
+struct Accumulator {
+    size_t count = 0;
+    double mean = 0;
+    double m2 = 0;
+    double min = 0;
+    double max = 0;
+
+    void add(double x) {
+        min = count ? std::min(min, x) : x;
+        max = count ? std::max(max, x) : x;
+        ++count;
+        const double delta = x - mean;
+        mean += delta / count;
+        m2 += delta * (x - mean);
+    }
+
+    // Chan et al.'s pairwise update
+    void merge(const Accumulator& other) {
+        if (other.count == 0)
+            return;
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        const size_t n = count + other.count;
+        const double delta = other.mean - mean;
+        mean += delta * other.count / n;
+        m2 += other.m2 + delta * delta * count * other.count / n;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        count = n;
+    }
+};
+using Accumulators = std::map<std::string, Accumulator>;
+
+// Buffered output would be written again by every child that inherits it,
+// and whatever a child buffers itself is lost at _exit
+void flush_output() {
+    std::cout.flush();
+    std::fflush(nullptr);
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool read_all(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// A block's summary on the wire: the block index, the number of metrics,
+// then per metric the name length, the name and the accumulator
+bool write_block(int fd, uint64_t block, const Accumulators& acc) {
+    const uint64_t size = acc.size();
+    if (!write_all(fd, &block, sizeof(block)) || !write_all(fd, &size, sizeof(size)))
+        return false;
+    for (const auto& [name, a] : acc) {
+        const uint64_t length = name.size();
+        if (!write_all(fd, &length, sizeof(length)) || !write_all(fd, name.data(), length) ||
+            !write_all(fd, &a, sizeof(a)))
+            return false;
+    }
+    return true;
+}
+
+// False at end of stream, with ok cleared if the stream was cut short
+bool read_block(int fd, uint64_t& block, Accumulators& acc, bool& ok) {
+    uint64_t size;
+    if (!read_all(fd, &block, sizeof(block)))
+        return false;
+    ok = read_all(fd, &size, sizeof(size));
+    acc.clear();
+    for (uint64_t i = 0; ok && i < size; ++i) {
+        uint64_t length;
+        std::string name;
+        ok = read_all(fd, &length, sizeof(length));
+        if (ok) {
+            name.resize(length);
+            ok = read_all(fd, name.data(), length) && read_all(fd, &acc[name], sizeof(Accumulator));
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+ReplicaRunner::ReplicaRunner(size_t replicas, size_t workers)
+    : replicas_(replicas), workers_(std::max<size_t>(1, std::min(workers, replicas))) {}
+
+void ReplicaRunner::seed(uint64_t base_run, uint64_t index) {
+    ns3::RngSeedManager::SetRun(base_run + index);
+    // Automatic stream numbers restart, so a replica's objects get the same
+    // streams whichever worker runs it and whatever ran there before
+    ns3::RngSeedManager::ResetNextStreamIndex();
+    CounterRng& fallback = CounterRng::thread_default();
+    fallback = CounterRng::from_seed_manager(fallback.stream());
+    std::seed_seq seq{static_cast<uint64_t>(ns3::RngSeedManager::GetSeed()), base_run, index};
+    qpp::RandomDevices::get_instance().get_prng().seed(seq);
+}
+
+ReplicaRunner::Summary ReplicaRunner::run(const Scenario& scenario) const {
+    const uint64_t base_run = ns3::RngSeedManager::GetRun();
+    const uint64_t blocks = (replicas_ + kBlockSize - 1) / kBlockSize;
+    std::vector<Accumulators> summaries(blocks);
+    auto run_block = [&](uint64_t block) {
+        Accumulators acc;
+        for (uint64_t i = block * kBlockSize; i < std::min<uint64_t>(replicas_, (block + 1) * kBlockSize); ++i) {
+            seed(base_run, i);
+            Metrics metrics = scenario({i, ns3::CreateObject<ns3::QuantumStateRegistry>()});
+            ns3::Simulator::Destroy();
+            for (const auto& [name, value] : metrics)
+                acc[name].add(value);
+        }
+        return acc;
+    };
+
+    const size_t workers = std::min<size_t>(workers_, blocks);
+    if (workers <= 1) {
+        for (uint64_t b = 0; b < blocks; ++b)
+            summaries[b] = run_block(b);
+    } else {
+        // Worker w runs blocks w, w + workers, ... and sends each one's
+        // summary back as it finishes; the pipes are read as data arrives,
+        // so no worker waits on a full pipe while another is being drained
+        std::vector<pid_t> pids;
+        std::vector<pollfd> fds;
+        for (size_t w = 0; w < workers; ++w) {
+            int fd[2];
+            NS_ABORT_MSG_IF(::pipe(fd) != 0, "pipe failed");
+            flush_output();
+            pid_t pid = ::fork();
+            NS_ABORT_MSG_IF(pid < 0, "fork failed");
+            if (pid == 0) {
+                ::close(fd[0]);
+                for (const pollfd& other : fds)
+                    ::close(other.fd);
+                bool ok = true;
+                for (uint64_t b = w; ok && b < blocks; b += workers)
+                    ok = write_block(fd[1], b, run_block(b));
+                flush_output();
+                ::_exit(ok ? 0 : 1);
+            }
+            ::close(fd[1]);
+            pids.push_back(pid);
+            fds.push_back({fd[0], POLLIN, 0});
+        }
+
+        bool ok = true;
+        uint64_t received = 0;
+        size_t open = fds.size();
+        while (ok && open > 0) {
+            NS_ABORT_MSG_IF(::poll(fds.data(), fds.size(), -1) < 0, "poll failed");
+            for (pollfd& p : fds) {
+                if (p.fd < 0 || !p.revents)
+                    continue;
+                uint64_t block;
+                Accumulators acc;
+                if (read_block(p.fd, block, acc, ok)) {
+                    ok = block < blocks;
+                    if (ok)
+                        summaries[block] = std::move(acc);
+                    ++received;
+                } else {
+                    ::close(p.fd);
+                    p.fd = -1; // poll skips negative fds
+                    --open;
+                }
+            }
+        }
+        for (const pollfd& p : fds)
+            if (p.fd >= 0)
+                ::close(p.fd);
+        for (pid_t pid : pids) {
+            int status = 0;
+            ::waitpid(pid, &status, 0);
+            ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        NS_ABORT_MSG_IF(!ok || received != blocks, "a replica worker failed");
+    }
+
+    Accumulators acc;
+    for (const auto& summary : summaries)
+        for (const auto& [name, a] : summary)
+            acc[name].merge(a);
+
+    ns3::RngSeedManager::SetRun(base_run);
+
+    Summary summary;
+    for (const auto& [name, a] : acc) {
+        Statistic& s = summary[name];
+        s.count = a.count;
+        s.mean = a.mean;
+        s.std_error = a.count > 1 ? std::sqrt(a.m2 / (a.count - 1) / a.count) : 0.0;
+        s.min = a.min;
+        s.max = a.max;
+    }
+    return summary;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "ns3/ptr.h"
+#include "2_quantum_state_registry.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+
+// Runs many isolated instances of a simulation and aggregates the named
+// metrics each one reports. The ns-3 simulator and node list are
+// process-global, so replicas run in forked worker processes, a slice of
+// replicas per core, rather than as threads; with one worker they run
+// in-process, one after the other. Every replica gets its own ns-3 run
+// number, which keys the random streams of its components, channels and
+// error models, plus a qpp seed for anything drawing from qpp directly;
+// results are reproducible and independent of the worker count. It also
+// gets a fresh QuantumStateRegistry to hand to its components' Registry
+// attribute. The simulator is destroyed after each replica.
+class ReplicaRunner {
+public:
+    struct Replica {
+        uint64_t index;
+        ns3::Ptr<ns3::QuantumStateRegistry> registry;
+    };
+
+    // A replica may leave out metrics that do not apply to it, e.g. a
+    // fidelity that only exists when the protocol succeeded
+    using Metrics = std::map<std::string, double>;
+    using Scenario = std::function<Metrics(const Replica&)>;
+
+    struct Statistic {
+        size_t count = 0; // replicas that reported the metric
+        double mean = 0;
+        double std_error = 0; // standard error of the mean
+        double min = 0;
+        double max = 0;
+    };
+    using Summary = std::map<std::string, Statistic>;
+
+    explicit ReplicaRunner(size_t replicas, size_t workers = std::thread::hardware_concurrency());
+
+    Summary run(const Scenario& scenario) const;
+
+    // Seeds ns-3 and qpp for replica index relative to base_run
+    static void seed(uint64_t base_run, uint64_t index);
+
+private:
+    size_t replicas_;
+    size_t workers_;
+};
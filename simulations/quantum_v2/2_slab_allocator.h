@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <new>
+
+// Pool of fixed-size blocks carved out of large chunks. Freed blocks go on
+// an intrusive free list and are reused before a new chunk is allocated.
+// The pool is never destroyed, so blocks can still be returned by objects
+// that outlive static destruction. Not thread-safe: a simulation runs on
+// one thread.
+template <size_t Size, size_t Align>
+class SlabPool {
+public:
+    static SlabPool& instance();
+
+    void* allocate();
+    void deallocate(void* p);
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static constexpr size_t kAlign = Align < alignof(FreeBlock) ? alignof(FreeBlock) : Align;
+    static constexpr size_t kMinSize = Size < sizeof(FreeBlock) ? sizeof(FreeBlock) : Size;
+    static constexpr size_t kBlockSize = (kMinSize + kAlign - 1) / kAlign * kAlign;
+    static constexpr size_t kBlocksPerChunk = 4096;
+
+    SlabPool() = default;
+
+    FreeBlock* free_ = nullptr;
+};
+
+// std allocator over SlabPool, for std::allocate_shared: the object and its
+// control block then share one pooled block
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    SlabAllocator() = default;
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>&) {}
+
+    T* allocate(size_t n);
+    void deallocate(T* p, size_t n);
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const SlabAllocator<U>&) const { return false; }
+};
+
+
+// ----------- Inline implementations ------------
+template <size_t Size, size_t Align>
+SlabPool<Size, Align>& SlabPool<Size, Align>::instance() {
+    static SlabPool* pool = new SlabPool;
+    return *pool;
+}
+
+template <size_t Size, size_t Align>
+void* SlabPool<Size, Align>::allocate() {
+    if (!free_) {
+        char* chunk = static_cast<char*>(::operator new(kBlockSize * kBlocksPerChunk, std::align_val_t(kAlign)));
+        for (size_t i = kBlocksPerChunk; i-- > 0;)
+            free_ = new (chunk + i * kBlockSize) FreeBlock{free_};
+    }
+    FreeBlock* block = free_;
+    free_ = block->next;
+    return block;
+}
+
+template <size_t Size, size_t Align>
+void SlabPool<Size, Align>::deallocate(void* p) {
+    free_ = new (p) FreeBlock{free_};
+}
+
+template <typename T>
+T* SlabAllocator<T>::allocate(size_t n) {
+    if (n != 1)
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    return static_cast<T*>(SlabPool<sizeof(T), alignof(T)>::instance().allocate());
+}
+
+template <typename T>
+void SlabAllocator<T>::deallocate(T* p, size_t n) {
+    if (n != 1) {
+        ::operator delete(p, std::align_val_t(alignof(T)));
+        return;
+    }
+    SlabPool<sizeof(T), alignof(T)>::instance().deallocate(p);
+}
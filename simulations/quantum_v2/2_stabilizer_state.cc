@@ -0,0 +1,352 @@
+#include "2_stabilizer_state.h"
+
+#include <bit>
+#include <utility>
+
+namespace {
+
+size_t words_for(size_t num_qubits) {
+    return (num_qubits + 63) / 64;
+}
+
+// ORs the src bit string into dst starting at bit offset.
+void or_shifted(uint64_t* dst, size_t dst_words, const uint64_t* src, size_t src_words, size_t offset) {
+    size_t ws = offset / 64, bs = offset % 64;
+    for (size_t w = 0; w < src_words && w + ws < dst_words; ++w) {
+        dst[w + ws] |= src[w] << bs;
+        if (bs && w + ws + 1 < dst_words)
+            dst[w + ws + 1] |= src[w] >> (64 - bs);
+    }
+}
+
+// Copies src into dst with bit `bit` deleted and all higher bits shifted down.
+void erase_bit(uint64_t* dst, size_t dst_words, const uint64_t* src, size_t src_words, size_t bit) {
+    size_t wb = bit / 64;
+    uint64_t low_mask = (uint64_t{1} << (bit % 64)) - 1;
+    for (size_t w = 0; w < dst_words; ++w) {
+        uint64_t cur = src[w];
+        uint64_t next = w + 1 < src_words ? src[w + 1] : 0;
+        if (w < wb)
+            dst[w] = cur;
+        else if (w == wb)
+            dst[w] = (cur & low_mask) | ((cur >> 1) & ~low_mask) | (next << 63);
+        else
+            dst[w] = (cur >> 1) | (next << 63);
+    }
+}
+
+} // namespace
+
+StabilizerState::StabilizerState(size_t num_qubits)
+    : n_(num_qubits), words_(words_for(num_qubits)),
+      x_((2 * num_qubits + 1) * words_for(num_qubits), 0),
+      z_((2 * num_qubits + 1) * words_for(num_qubits), 0),
+      r_(2 * num_qubits + 1, 0) {
+    for (size_t i = 0; i < n_; ++i) {
+        x_[i * words_ + i / 64] |= uint64_t{1} << (i % 64);        // destabilizer X_i
+        z_[(i + n_) * words_ + i / 64] |= uint64_t{1} << (i % 64); // stabilizer Z_i
+    }
+}
+
+// ----------- Clifford gates ------------
+void StabilizerState::apply_h(qpp::idx q) {
+    const size_t w = q / 64;
+    const uint64_t m = uint64_t{1} << (q % 64);
+    for (size_t i = 0; i < 2 * n_; ++i) {
+        uint64_t& xw = x_[i * words_ + w];
+        uint64_t& zw = z_[i * words_ + w];
+        bool xb = xw & m, zb = zw & m;
+        r_[i] ^= xb & zb;
+        if (xb != zb) {
+            xw ^= m;
+            zw ^= m;
+        }
+    }
+}
+
+void StabilizerState::apply_s(qpp::idx q) {
+    const size_t w = q / 64;
+    const uint64_t m = uint64_t{1} << (q % 64);
+    for (size_t i = 0; i < 2 * n_; ++i) {
+        uint64_t xb = x_[i * words_ + w] & m;
+        r_[i] ^= (xb & z_[i * words_ + w]) != 0;
+        z_[i * words_ + w] ^= xb;
+    }
+}
+
+void StabilizerState::apply_x(qpp::idx q) {
+    for (size_t i = 0; i < 2 * n_; ++i)
+        r_[i] ^= z(i, q);
+}
+
+void StabilizerState::apply_y(qpp::idx q) {
+    for (size_t i = 0; i < 2 * n_; ++i)
+        r_[i] ^= x(i, q) ^ z(i, q);
+}
+
+void StabilizerState::apply_z(qpp::idx q) {
+    for (size_t i = 0; i < 2 * n_; ++i)
+        r_[i] ^= x(i, q);
+}
+
+void StabilizerState::apply_cnot(qpp::idx control, qpp::idx target) {
+    const size_t wc = control / 64, wt = target / 64;
+    const uint64_t mc = uint64_t{1} << (control % 64), mt = uint64_t{1} << (target % 64);
+    for (size_t i = 0; i < 2 * n_; ++i) {
+        bool xc = x_[i * words_ + wc] & mc, zc = z_[i * words_ + wc] & mc;
+        bool xt = x_[i * words_ + wt] & mt, zt = z_[i * words_ + wt] & mt;
+        r_[i] ^= xc & zt & (xt ^ zc ^ 1);
+        if (xc)
+            x_[i * words_ + wt] ^= mt;
+        if (zt)
+            z_[i * words_ + wc] ^= mc;
+    }
+}
+
+void StabilizerState::apply_cz(qpp::idx a, qpp::idx b) {
+    apply_h(b);
+    apply_cnot(a, b);
+    apply_h(b);
+}
+
+void StabilizerState::apply_swap(qpp::idx a, qpp::idx b) {
+    for (size_t i = 0; i < 2 * n_; ++i) {
+        for (auto* bits : {&x_, &z_}) {
+            uint64_t& wa = (*bits)[i * words_ + a / 64];
+            uint64_t& wb = (*bits)[i * words_ + b / 64];
+            bool ba = (wa >> (a % 64)) & 1, bb = (wb >> (b % 64)) & 1;
+            if (ba != bb) {
+                wa ^= uint64_t{1} << (a % 64);
+                wb ^= uint64_t{1} << (b % 64);
+            }
+        }
+    }
+}
+
+bool StabilizerState::apply_gate(const Gate& gate, const std::vector<qpp::idx>& targets) {
+    switch (gate.kind()) {
+    case Gate::IDENTITY: return true;
+    case Gate::X: apply_x(targets[0]); return true;
+    case Gate::Y: apply_y(targets[0]); return true;
+    case Gate::Z: apply_z(targets[0]); return true;
+    case Gate::H: apply_h(targets[0]); return true;
+    case Gate::S: apply_s(targets[0]); return true;
+    case Gate::SDG: apply_z(targets[0]); apply_s(targets[0]); return true;
+    case Gate::CNOT: apply_cnot(targets[0], targets[1]); return true;
+    case Gate::CZ: apply_cz(targets[0], targets[1]); return true;
+    case Gate::SWAP: apply_swap(targets[0], targets[1]); return true;
+    default: return false;
+    }
+}
+
+// ----------- Row operations ------------
+
+// Row h becomes P_i * P_h, tracking the sign (Aaronson–Gottesman "rowsum").
+// The phase sum of g(x_i, z_i, x_h, z_h) is evaluated a word at a time by
+// counting the +1 and -1 contributions separately.
+void StabilizerState::rowsum(size_t h, size_t i) {
+    int sum = 2 * r_[h] + 2 * r_[i];
+    for (size_t w = 0; w < words_; ++w) {
+        uint64_t x1 = x_[i * words_ + w], z1 = z_[i * words_ + w];
+        uint64_t x2 = x_[h * words_ + w], z2 = z_[h * words_ + w];
+        uint64_t pos = (x1 & z1 & z2 & ~x2) | (x1 & ~z1 & x2 & z2) | (~x1 & z1 & x2 & ~z2);
+        uint64_t neg = (x1 & z1 & x2 & ~z2) | (x1 & ~z1 & ~x2 & z2) | (~x1 & z1 & x2 & z2);
+        sum += std::popcount(pos) - std::popcount(neg);
+        x_[h * words_ + w] = x1 ^ x2;
+        z_[h * words_ + w] = z1 ^ z2;
+    }
+    r_[h] = (((sum % 4) + 4) % 4) >> 1;
+}
+
+void StabilizerState::rowcopy(size_t dst, size_t src) {
+    std::copy_n(&x_[src * words_], words_, &x_[dst * words_]);
+    std::copy_n(&z_[src * words_], words_, &z_[dst * words_]);
+    r_[dst] = r_[src];
+}
+
+void StabilizerState::rowclear(size_t row) {
+    std::fill_n(&x_[row * words_], words_, 0);
+    std::fill_n(&z_[row * words_], words_, 0);
+    r_[row] = 0;
+}
+
+void StabilizerState::rowswap(size_t a, size_t b) {
+    std::swap_ranges(&x_[a * words_], &x_[a * words_] + words_, &x_[b * words_]);
+    std::swap_ranges(&z_[a * words_], &z_[a * words_] + words_, &z_[b * words_]);
+    std::swap(r_[a], r_[b]);
+}
+
+// ----------- Measurement ------------
+qpp::idx StabilizerState::measure(qpp::idx target, double u) {
+    const size_t scratch = 2 * n_;
+    size_t p = scratch;
+    for (size_t i = n_; i < 2 * n_; ++i) {
+        if (x(i, target)) {
+            p = i;
+            break;
+        }
+    }
+
+    qpp::idx outcome;
+    size_t destab; // destabilizer paired with the stabilizer row that becomes ±Z_target
+    if (p != scratch) {
+        // Random outcome
+        for (size_t i = 0; i < 2 * n_; ++i) {
+            if (i != p && x(i, target))
+                rowsum(i, p);
+        }
+        destab = p - n_;
+        rowcopy(destab, p);
+        outcome = u < 0.5 ? 0 : 1;
+    } else {
+        // Deterministic outcome: Z_target is already in the stabilizer group
+        rowclear(scratch);
+        destab = n_;
+        for (size_t i = 0; i < n_; ++i) {
+            if (x(i, target)) {
+                rowsum(scratch, i + n_);
+                if (destab == n_)
+                    destab = i;
+            }
+        }
+        outcome = r_[scratch];
+        for (size_t i = destab + 1; i < n_; ++i) {
+            if (x(i, target))
+                rowsum(i, destab);
+        }
+    }
+
+    rowclear(destab + n_);
+    z_[(destab + n_) * words_ + target / 64] |= uint64_t{1} << (target % 64);
+    r_[destab + n_] = static_cast<uint8_t>(outcome);
+
+    remove_qubit(target, destab);
+    return outcome;
+}
+
+// Drops target, which must be in a Z eigenstate held by stabilizer row
+// destab+n with destab the only destabilizer acting as X/Y on it.
+void StabilizerState::remove_qubit(qpp::idx target, size_t destab) {
+    const size_t stab = destab + n_;
+    for (size_t i = n_; i < 2 * n_; ++i) {
+        if (i != stab && z(i, target))
+            rowsum(i, stab);
+    }
+
+    StabilizerState reduced(n_ - 1);
+    size_t row = 0;
+    for (size_t i = 0; i < 2 * n_; ++i) {
+        if (i == destab || i == stab)
+            continue;
+        erase_bit(&reduced.x_[row * reduced.words_], reduced.words_, &x_[i * words_], words_, target);
+        erase_bit(&reduced.z_[row * reduced.words_], reduced.words_, &z_[i * words_], words_, target);
+        reduced.r_[row] = r_[i];
+        ++row;
+    }
+    *this = std::move(reduced);
+}
+
+// ----------- Composition ------------
+void StabilizerState::append(const StabilizerState& other) {
+    StabilizerState joint(n_ + other.n_);
+    joint.x_.assign(joint.x_.size(), 0);
+    joint.z_.assign(joint.z_.size(), 0);
+
+    auto place = [&](const StabilizerState& src, size_t src_row, size_t dst_row, size_t offset) {
+        or_shifted(&joint.x_[dst_row * joint.words_], joint.words_, &src.x_[src_row * src.words_], src.words_, offset);
+        or_shifted(&joint.z_[dst_row * joint.words_], joint.words_, &src.z_[src_row * src.words_], src.words_, offset);
+        joint.r_[dst_row] = src.r_[src_row];
+    };
+
+    const size_t N = joint.n_;
+    for (size_t i = 0; i < n_; ++i) {
+        place(*this, i, i, 0);
+        place(*this, i + n_, i + N, 0);
+    }
+    for (size_t i = 0; i < other.n_; ++i) {
+        place(other, i, n_ + i, n_);
+        place(other, i + other.n_, N + n_ + i, n_);
+    }
+    *this = std::move(joint);
+}
+
+// ----------- Conversion ------------
+
+// Finds a computational basis state |b⟩ with ⟨b|ψ⟩ != 0 by Gaussian
+// elimination, then projects it onto the stabilized subspace.
+qpp::ket StabilizerState::to_ket() const {
+    const qpp::idx D = qpp::idx{1} << n_;
+    StabilizerState t = *this;
+
+    size_t k = n_;
+    for (size_t q = 0; q < n_; ++q) {
+        size_t i = k;
+        while (i < 2 * n_ && !t.x(i, q)) ++i;
+        if (i == 2 * n_) continue;
+        t.rowswap(i, k);
+        for (size_t j = n_; j < 2 * n_; ++j) {
+            if (j != k && t.x(j, q))
+                t.rowsum(j, k);
+        }
+        ++k;
+    }
+
+    // Remaining rows are Z-type: ±Z^v fixes v·b = r (mod 2)
+    qpp::idx b = 0;
+    const size_t zstart = k;
+    for (size_t q = 0; q < n_; ++q) {
+        size_t i = k;
+        while (i < 2 * n_ && !t.z(i, q)) ++i;
+        if (i == 2 * n_) continue;
+        t.rowswap(i, k);
+        for (size_t j = zstart; j < 2 * n_; ++j) {
+            if (j != k && t.z(j, q))
+                t.rowsum(j, k);
+        }
+        ++k;
+    }
+    for (size_t i = zstart; i < 2 * n_; ++i) {
+        for (size_t q = 0; q < n_; ++q) {
+            if (t.z(i, q)) {
+                if (t.r_[i])
+                    b |= qpp::idx{1} << (n_ - 1 - q);
+                break;
+            }
+        }
+    }
+
+    qpp::ket psi = qpp::ket::Zero(D);
+    psi(b) = 1;
+    for (size_t i = n_; i < 2 * n_; ++i) {
+        qpp::idx xmask = 0, zmask = 0;
+        int ys = 0;
+        for (size_t q = 0; q < n_; ++q) {
+            qpp::idx bit = qpp::idx{1} << (n_ - 1 - q);
+            if (x(i, q)) xmask |= bit;
+            if (z(i, q)) zmask |= bit;
+            ys += x(i, q) & z(i, q);
+        }
+        static const qpp::cplx ipow[4] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+        qpp::cplx phase = ipow[(ys + 2 * r_[i]) % 4];
+        qpp::ket projected = psi;
+        for (qpp::idx y = 0; y < D; ++y) {
+            if (psi(y) == qpp::cplx(0))
+                continue;
+            double sign = std::popcount(zmask & y) % 2 ? -1.0 : 1.0;
+            projected(y ^ xmask) += sign * phase * psi(y);
+        }
+        psi = projected / 2.0;
+    }
+    return psi / psi.norm();
+}
+
+std::ostream& operator<<(std::ostream& os, const StabilizerState& s) {
+    static const char paulis[4] = {'I', 'X', 'Z', 'Y'};
+    for (size_t i = s.n_; i < 2 * s.n_; ++i) {
+        os << (s.r_[i] ? '-' : '+');
+        for (size_t q = 0; q < s.n_; ++q)
+            os << paulis[s.x(i, q) | (s.z(i, q) << 1)];
+        os << "\n";
+    }
+    return os;
+}
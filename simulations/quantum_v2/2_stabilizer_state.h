@@ -0,0 +1,58 @@
+#pragma once
+#include "qpp/qpp.hpp"
+#include "2_gate.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Aaronson–Gottesman (CHP) tableau for an n-qubit stabilizer state.
+// Rows 0..n-1 are destabilizers, rows n..2n-1 are stabilizers and row 2n is
+// scratch space. Each row is a bit-packed Pauli string plus a sign bit, so
+// Clifford gates cost O(n) and measurements O(n^2) instead of O(2^n).
+class StabilizerState {
+public:
+    StabilizerState(size_t num_qubits = 0); // |00...0⟩
+
+    size_t num_qubits() const { return n_; }
+
+    void apply_h(qpp::idx q);
+    void apply_s(qpp::idx q);
+    void apply_x(qpp::idx q);
+    void apply_y(qpp::idx q);
+    void apply_z(qpp::idx q);
+    void apply_cnot(qpp::idx control, qpp::idx target);
+    void apply_cz(qpp::idx a, qpp::idx b);
+    void apply_swap(qpp::idx a, qpp::idx b);
+
+    // Applies gate if it is a Clifford kind. Returns false, leaving the
+    // tableau untouched, otherwise.
+    bool apply_gate(const Gate& gate, const std::vector<qpp::idx>& targets);
+
+    // Z-basis measurement of target with uniform sample u in [0, 1), used
+    // only if the outcome is random. The measured qubit is removed, leaving
+    // the (n-1)-qubit post-measurement state of the remaining qubits.
+    qpp::idx measure(qpp::idx target, double u);
+
+    // Tensor product with other; other's qubits are appended after ours.
+    void append(const StabilizerState& other);
+
+    // Dense amplitudes, O(n 2^n). Only sensible for small n.
+    qpp::ket to_ket() const;
+
+    friend std::ostream& operator<<(std::ostream& os, const StabilizerState& s);
+
+private:
+    bool x(size_t row, qpp::idx q) const { return (x_[row * words_ + q / 64] >> (q % 64)) & 1; }
+    bool z(size_t row, qpp::idx q) const { return (z_[row * words_ + q / 64] >> (q % 64)) & 1; }
+    void rowsum(size_t h, size_t i);
+    void rowcopy(size_t dst, size_t src);
+    void rowclear(size_t row);
+    void rowswap(size_t a, size_t b);
+    void remove_qubit(qpp::idx target, size_t destab_row);
+
+    size_t n_;
+    size_t words_;
+    std::vector<uint64_t> x_;
+    std::vector<uint64_t> z_;
+    std::vector<uint8_t> r_;
+};
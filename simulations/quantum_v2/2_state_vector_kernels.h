@@ -0,0 +1,501 @@
+#pragma once
+#include "qpp/qpp.hpp"
+#include "2_gate.h"
+#include "2_thread_pool.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+// In-place gate kernels on a dense n-qubit ket. Qubit 0 is the most
+// significant bit of the amplitude index (qpp's convention), so qubit t
+// pairs amplitudes that are 2^(n-1-t) apart.
+//
+// Complex products are written out on the real/imaginary parts so the
+// compiler can vectorize the inner loops without the NaN-recovery calls
+// that std::complex multiplication otherwise emits.
+//
+// Kernels over states of at least 2^QuantumParallelQubits amplitudes split
+// their work across the ThreadPool; reductions sum per-chunk partials in
+// chunk order, so results only depend on the thread count.
+namespace kernels {
+
+using qpp::idx;
+
+// Index with a zero bit inserted at position pos
+inline idx insert_zero_bit(idx i, idx pos) {
+    return ((i >> pos) << (pos + 1)) | (i & ((idx{1} << pos) - 1));
+}
+
+// Number of chunks parallel_for splits a kernel over D amplitudes into
+inline size_t parallel_chunks(idx D) {
+    return ThreadPool::instance().chunks(D);
+}
+
+// Calls body(chunk, begin, end) over parallel_chunks(D) pieces of [0, count)
+template <typename F>
+inline void parallel_for(idx D, idx count, F&& body) {
+    ThreadPool& pool = ThreadPool::instance();
+    const size_t chunks = pool.chunks(D);
+    if (chunks == 1)
+        body(0, 0, count);
+    else
+        pool.run(count, chunks, body);
+}
+
+// The amplitude pairs (i, i + stride) that a single-qubit gate mixes,
+// numbered in index order, come in runs of stride consecutive pairs. Calls
+// run(base, len) for each run, or part of one, in pairs [begin, end); base
+// is the index of its first |0⟩ amplitude.
+template <typename F>
+inline void for_each_pair_run(idx stride, idx begin, idx end, F&& run) {
+    for (idx j = begin; j < end;) {
+        const idx k = j & (stride - 1);
+        const idx len = std::min(stride - k, end - j);
+        run(2 * j - k, len);
+        j += len;
+    }
+}
+
+// for_each_pair_run over all D/2 pairs, in parallel for large states
+template <typename F>
+inline void parallel_pairs(idx D, idx stride, F&& run) {
+    parallel_for(D, D / 2, [&](size_t, idx begin, idx end) { for_each_pair_run(stride, begin, end, run); });
+}
+
+inline void apply_1q(qpp::ket& psi, const qpp::cmat& U, idx n, idx target) {
+    const idx stride = idx{1} << (n - 1 - target);
+    const idx D = static_cast<idx>(psi.size());
+    const double u00r = U(0, 0).real(), u00i = U(0, 0).imag();
+    const double u01r = U(0, 1).real(), u01i = U(0, 1).imag();
+    const double u10r = U(1, 0).real(), u10i = U(1, 0).imag();
+    const double u11r = U(1, 1).real(), u11i = U(1, 1).imag();
+    double* amp = reinterpret_cast<double*>(psi.data());
+
+    parallel_pairs(D, stride, [=](idx base, idx len) {
+        double* __restrict lo = amp + 2 * base;
+        double* __restrict hi = amp + 2 * (base + stride);
+        for (idx k = 0; k < len; ++k) {
+            const double ar = lo[2 * k], ai = lo[2 * k + 1];
+            const double br = hi[2 * k], bi = hi[2 * k + 1];
+            lo[2 * k]     = u00r * ar - u00i * ai + u01r * br - u01i * bi;
+            lo[2 * k + 1] = u00r * ai + u00i * ar + u01r * bi + u01i * br;
+            hi[2 * k]     = u10r * ar - u10i * ai + u11r * br - u11i * bi;
+            hi[2 * k + 1] = u10r * ai + u10i * ar + u11r * bi + u11i * br;
+        }
+    });
+}
+
+// targets = {a, b}; U is indexed as |a b⟩ like qpp::apply
+inline void apply_2q(qpp::ket& psi, const qpp::cmat& U, idx n, idx a, idx b) {
+    const idx pa = n - 1 - a, pb = n - 1 - b;
+    const idx ma = idx{1} << pa, mb = idx{1} << pb;
+    const idx plo = pa < pb ? pa : pb, phi = pa < pb ? pb : pa;
+    const idx quarter = static_cast<idx>(psi.size()) / 4;
+
+    double ur[4][4], ui[4][4];
+    for (int r = 0; r < 4; ++r) {
+        for (int c = 0; c < 4; ++c) {
+            ur[r][c] = U(r, c).real();
+            ui[r][c] = U(r, c).imag();
+        }
+    }
+    double* amp = reinterpret_cast<double*>(psi.data());
+
+    parallel_for(psi.size(), quarter, [&](size_t, idx begin, idx end) {
+        for (idx j = begin; j < end; ++j) {
+            const idx i0 = insert_zero_bit(insert_zero_bit(j, plo), phi);
+            const idx ids[4] = {i0, i0 | mb, i0 | ma, i0 | ma | mb};
+            double xr[4], xi[4];
+            for (int c = 0; c < 4; ++c) {
+                xr[c] = amp[2 * ids[c]];
+                xi[c] = amp[2 * ids[c] + 1];
+            }
+            for (int r = 0; r < 4; ++r) {
+                double yr = 0, yi = 0;
+                for (int c = 0; c < 4; ++c) {
+                    yr += ur[r][c] * xr[c] - ui[r][c] * xi[c];
+                    yi += ur[r][c] * xi[c] + ui[r][c] * xr[c];
+                }
+                amp[2 * ids[r]] = yr;
+                amp[2 * ids[r] + 1] = yi;
+            }
+        }
+    });
+}
+
+// Probability that measuring target gives 1
+inline double probability_one(const qpp::ket& psi, idx n, idx target) {
+    const idx stride = idx{1} << (n - 1 - target);
+    const idx D = static_cast<idx>(psi.size());
+    const double* amp = reinterpret_cast<const double*>(psi.data());
+
+    std::vector<double> partial(parallel_chunks(D), 0.0);
+    parallel_for(D, D / 2, [&](size_t chunk, idx begin, idx end) {
+        double sum = 0;
+        for_each_pair_run(stride, begin, end, [&](idx base, idx len) {
+            const double* hi = amp + 2 * (base + stride);
+            for (idx k = 0; k < 2 * len; ++k)
+                sum += hi[k] * hi[k];
+        });
+        partial[chunk] = sum;
+    });
+    return std::accumulate(partial.begin(), partial.end(), 0.0);
+}
+
+// Keeps the half of the amplitudes where target is result, whose
+// probability is p, renormalized and compacted to the front of the buffer,
+// which then shrinks to n-1 qubits. Serial: compacting in place is
+// order-dependent.
+inline void collapse(qpp::ket& psi, idx n, idx target, idx result, double p) {
+    const idx stride = idx{1} << (n - 1 - target);
+    const idx D = static_cast<idx>(psi.size());
+    const double scale = 1.0 / std::sqrt(p);
+    qpp::cplx* data = psi.data();
+    for (idx base = 0, dst = 0; base < D; base += 2 * stride, dst += stride) {
+        const qpp::cplx* src = data + base + result * stride;
+        for (idx k = 0; k < stride; ++k)
+            data[dst + k] = src[k] * scale;
+    }
+    psi.conservativeResize(D / 2);
+}
+
+// Z-basis measurement of target with uniform sample u in [0, 1)
+inline idx measure(qpp::ket& psi, idx n, idx target, double u) {
+    const double p1 = probability_one(psi, n, target);
+    const idx result = u < p1 ? 1 : 0;
+    collapse(psi, n, target, result, result ? p1 : 1.0 - p1);
+    return result;
+}
+
+// Joint Z-basis measurement of targets. One pass accumulates the 2^k outcome
+// probabilities, a second compacts the matching amplitudes to the front of
+// the buffer, which then shrinks to n-k qubits. The returned outcome has
+// targets[0] as its most significant bit.
+inline idx measure(qpp::ket& psi, idx n, const std::vector<idx>& targets, double u) {
+    const idx k = targets.size();
+    const idx D = static_cast<idx>(psi.size());
+    std::vector<idx> masks(k);
+    idx all = 0;
+    for (idx j = 0; j < k; ++j) {
+        masks[j] = idx{1} << (n - 1 - targets[j]);
+        all |= masks[j];
+    }
+
+    qpp::cplx* data = psi.data();
+    std::vector<std::vector<double>> partial(parallel_chunks(D));
+    parallel_for(D, D, [&](size_t chunk, idx begin, idx end) {
+        std::vector<double> p(idx{1} << k, 0.0);
+        for (idx i = begin; i < end; ++i) {
+            idx o = 0;
+            for (idx j = 0; j < k; ++j)
+                o = (o << 1) | ((i & masks[j]) != 0);
+            p[o] += std::norm(data[i]);
+        }
+        partial[chunk] = std::move(p);
+    });
+    std::vector<double> probs(idx{1} << k, 0.0);
+    for (const auto& p : partial)
+        for (idx o = 0; o < probs.size(); ++o)
+            probs[o] += p[o];
+
+    idx result = 0;
+    double acc = 0;
+    for (idx o = 0; o < probs.size(); ++o) {
+        if (probs[o] == 0)
+            continue;
+        acc += probs[o];
+        result = o;
+        if (u < acc)
+            break;
+    }
+
+    idx pattern = 0;
+    for (idx j = 0; j < k; ++j)
+        if ((result >> (k - 1 - j)) & 1)
+            pattern |= masks[j];
+    const double scale = 1.0 / std::sqrt(probs[result]);
+    idx dst = 0;
+    for (idx i = 0; i < D; ++i)
+        if ((i & all) == pattern)
+            data[dst++] = data[i] * scale;
+    psi.conservativeResize(D >> k);
+    return result;
+}
+
+// ----------- Permutation and phase-only kernels ------------
+
+inline void apply_x(qpp::ket& psi, idx n, idx target) {
+    const idx stride = idx{1} << (n - 1 - target);
+    qpp::cplx* amp = psi.data();
+    parallel_pairs(psi.size(), stride, [=](idx base, idx len) {
+        std::swap_ranges(amp + base, amp + base + len, amp + base + stride);
+    });
+}
+
+// Y = [[0, -i], [i, 0]]: a swap plus a quarter turn on each half
+inline void apply_y(qpp::ket& psi, idx n, idx target) {
+    const idx stride = idx{1} << (n - 1 - target);
+    const idx D = static_cast<idx>(psi.size());
+    double* amp = reinterpret_cast<double*>(psi.data());
+    parallel_pairs(D, stride, [=](idx base, idx len) {
+        double* __restrict lo = amp + 2 * base;
+        double* __restrict hi = amp + 2 * (base + stride);
+        for (idx k = 0; k < len; ++k) {
+            const double ar = lo[2 * k], ai = lo[2 * k + 1];
+            lo[2 * k] = hi[2 * k + 1];
+            lo[2 * k + 1] = -hi[2 * k];
+            hi[2 * k] = -ai;
+            hi[2 * k + 1] = ar;
+        }
+    });
+}
+
+inline void apply_z(qpp::ket& psi, idx n, idx target) {
+    const idx stride = idx{1} << (n - 1 - target);
+    const idx D = static_cast<idx>(psi.size());
+    double* amp = reinterpret_cast<double*>(psi.data());
+    parallel_pairs(D, stride, [=](idx base, idx len) {
+        double* __restrict hi = amp + 2 * (base + stride);
+        for (idx k = 0; k < 2 * len; ++k)
+            hi[k] = -hi[k];
+    });
+}
+
+// Multiplies the |1⟩ half by +i (S) or -i (S†)
+inline void apply_s(qpp::ket& psi, idx n, idx target, bool dagger) {
+    const idx stride = idx{1} << (n - 1 - target);
+    const idx D = static_cast<idx>(psi.size());
+    const double sign = dagger ? -1.0 : 1.0;
+    double* amp = reinterpret_cast<double*>(psi.data());
+    parallel_pairs(D, stride, [=](idx base, idx len) {
+        double* __restrict hi = amp + 2 * (base + stride);
+        for (idx k = 0; k < len; ++k) {
+            const double r = hi[2 * k];
+            hi[2 * k] = -sign * hi[2 * k + 1];
+            hi[2 * k + 1] = sign * r;
+        }
+    });
+}
+
+// Multiplies the |1⟩ half by phase, i.e. diag(1, phase)
+inline void apply_phase(qpp::ket& psi, idx n, idx target, qpp::cplx phase) {
+    const idx stride = idx{1} << (n - 1 - target);
+    const idx D = static_cast<idx>(psi.size());
+    const double cr = phase.real(), ci = phase.imag();
+    double* amp = reinterpret_cast<double*>(psi.data());
+    parallel_pairs(D, stride, [=](idx base, idx len) {
+        double* __restrict hi = amp + 2 * (base + stride);
+        for (idx k = 0; k < len; ++k) {
+            const double r = hi[2 * k], i = hi[2 * k + 1];
+            hi[2 * k] = cr * r - ci * i;
+            hi[2 * k + 1] = cr * i + ci * r;
+        }
+    });
+}
+
+inline void apply_cnot(qpp::ket& psi, idx n, idx control, idx target) {
+    const idx pc = n - 1 - control, pt = n - 1 - target;
+    const idx mc = idx{1} << pc, mt = idx{1} << pt;
+    const idx plo = pc < pt ? pc : pt, phi = pc < pt ? pt : pc;
+    const idx quarter = static_cast<idx>(psi.size()) / 4;
+    qpp::cplx* amp = psi.data();
+    parallel_for(psi.size(), quarter, [=](size_t, idx begin, idx end) {
+        for (idx j = begin; j < end; ++j) {
+            const idx i0 = insert_zero_bit(insert_zero_bit(j, plo), phi) | mc;
+            std::swap(amp[i0], amp[i0 | mt]);
+        }
+    });
+}
+
+inline void apply_cz(qpp::ket& psi, idx n, idx a, idx b) {
+    const idx pa = n - 1 - a, pb = n - 1 - b;
+    const idx mask = (idx{1} << pa) | (idx{1} << pb);
+    const idx plo = pa < pb ? pa : pb, phi = pa < pb ? pb : pa;
+    const idx quarter = static_cast<idx>(psi.size()) / 4;
+    qpp::cplx* amp = psi.data();
+    parallel_for(psi.size(), quarter, [=](size_t, idx begin, idx end) {
+        for (idx j = begin; j < end; ++j) {
+            const idx i = insert_zero_bit(insert_zero_bit(j, plo), phi) | mask;
+            amp[i] = -amp[i];
+        }
+    });
+}
+
+inline void apply_swap(qpp::ket& psi, idx n, idx a, idx b) {
+    const idx pa = n - 1 - a, pb = n - 1 - b;
+    const idx ma = idx{1} << pa, mb = idx{1} << pb;
+    const idx plo = pa < pb ? pa : pb, phi = pa < pb ? pb : pa;
+    const idx quarter = static_cast<idx>(psi.size()) / 4;
+    qpp::cplx* amp = psi.data();
+    parallel_for(psi.size(), quarter, [=](size_t, idx begin, idx end) {
+        for (idx j = begin; j < end; ++j) {
+            const idx i0 = insert_zero_bit(insert_zero_bit(j, plo), phi);
+            std::swap(amp[i0 | ma], amp[i0 | mb]);
+        }
+    });
+}
+
+// a ⊗ b, filled in parallel for large results
+inline qpp::ket kron(const qpp::ket& a, const qpp::ket& b) {
+    const idx Db = static_cast<idx>(b.size());
+    qpp::ket out(a.size() * b.size());
+    parallel_for(out.size(), out.size(), [&](size_t, idx begin, idx end) {
+        for (idx i = begin; i < end;) {
+            const idx row = i / Db, col = i % Db;
+            const idx len = std::min(Db - col, end - i);
+            out.segment(i, len) = a(row) * b.segment(col, len);
+            i += len;
+        }
+    });
+    return out;
+}
+
+// Dense U on targets, with no attempt to recognize it
+inline void apply_matrix(qpp::ket& psi, const qpp::cmat& U, const std::vector<idx>& targets, idx n) {
+    if (targets.size() == 1)
+        apply_1q(psi, U, n, targets[0]);
+    else if (targets.size() == 2)
+        apply_2q(psi, U, n, targets[0], targets[1]);
+    else
+        psi = qpp::apply(psi, U, targets);
+}
+
+// Dispatches named gates to the permutation/phase kernels and everything
+// else to the dense in-place kernels, falling back to qpp for wider gates
+inline void apply(qpp::ket& psi, const Gate& gate, const std::vector<idx>& targets, idx n) {
+    switch (gate.kind()) {
+    case Gate::IDENTITY: return;
+    case Gate::X: return apply_x(psi, n, targets[0]);
+    case Gate::Y: return apply_y(psi, n, targets[0]);
+    case Gate::Z: return apply_z(psi, n, targets[0]);
+    case Gate::S: return apply_s(psi, n, targets[0], false);
+    case Gate::SDG: return apply_s(psi, n, targets[0], true);
+    case Gate::T: return apply_phase(psi, n, targets[0], std::polar(1.0, qpp::pi / 4));
+    case Gate::TDG: return apply_phase(psi, n, targets[0], std::polar(1.0, -qpp::pi / 4));
+    case Gate::CNOT: return apply_cnot(psi, n, targets[0], targets[1]);
+    case Gate::CZ: return apply_cz(psi, n, targets[0], targets[1]);
+    case Gate::SWAP: return apply_swap(psi, n, targets[0], targets[1]);
+    default: break;
+    }
+
+    apply_matrix(psi, gate.matrix(), targets, n);
+}
+
+// ----------- Separability ------------
+
+// Amplitude-index bits of qubits for each of their 2^k values, qubits[0]
+// most significant
+inline std::vector<idx> subsystem_offsets(idx n, const std::vector<idx>& qubits) {
+    const idx k = qubits.size();
+    std::vector<idx> offsets(idx{1} << k, 0);
+    for (idx v = 0; v < offsets.size(); ++v)
+        for (idx j = 0; j < k; ++j)
+            if ((v >> (k - 1 - j)) & 1)
+                offsets[v] |= idx{1} << (n - 1 - qubits[j]);
+    return offsets;
+}
+
+// The qubits not in qubits, in ascending order
+inline std::vector<idx> complement(idx n, const std::vector<idx>& qubits) {
+    std::vector<idx> rest;
+    for (idx q = 0; q < n; ++q)
+        if (std::find(qubits.begin(), qubits.end(), q) == qubits.end())
+            rest.push_back(q);
+    return rest;
+}
+
+// Reduced density matrix of a few qubits, tracing out the rest in one pass
+inline qpp::cmat marginal(const qpp::ket& psi, idx n, const std::vector<idx>& qubits) {
+    const std::vector<idx> sub = subsystem_offsets(n, qubits);
+    const std::vector<idx> rest = subsystem_offsets(n, complement(n, qubits));
+    const idx d = sub.size();
+    qpp::cmat rho = qpp::cmat::Zero(d, d);
+    for (idx r : rest)
+        for (idx a = 0; a < d; ++a)
+            for (idx b = 0; b < d; ++b)
+                rho(a, b) += psi(r | sub[a]) * std::conj(psi(r | sub[b]));
+    return rho;
+}
+
+// Groups qubits that may be entangled with each other: a qubit with a pure
+// marginal is on its own, and two mixed qubits are linked when their joint
+// marginal differs from the product of their single-qubit ones. Different
+// groups are pairwise uncorrelated, which a product state requires but does
+// not guarantee, so split() still confirms each group. Smallest first.
+inline std::vector<std::vector<idx>> correlated_groups(const qpp::ket& psi, idx n, double tol = 1e-9) {
+    std::vector<qpp::cmat> rho(n);
+    std::vector<idx> mixed;
+    for (idx q = 0; q < n; ++q) {
+        rho[q] = marginal(psi, n, {q});
+        if (1.0 - (rho[q] * rho[q]).trace().real() > tol)
+            mixed.push_back(q);
+    }
+
+    std::vector<idx> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](idx q) {
+        while (parent[q] != q)
+            q = parent[q] = parent[parent[q]];
+        return q;
+    };
+    for (size_t i = 0; i < mixed.size(); ++i) {
+        for (size_t j = i + 1; j < mixed.size(); ++j) {
+            const idx a = mixed[i], b = mixed[j];
+            if (find(a) == find(b))
+                continue;
+            if ((marginal(psi, n, {a, b}) - qpp::kron(rho[a], rho[b])).norm() > tol)
+                parent[find(b)] = find(a);
+        }
+    }
+
+    std::vector<std::vector<idx>> groups;
+    std::vector<idx> group_of(n, n);
+    for (idx q = 0; q < n; ++q) {
+        const idx root = find(q);
+        if (group_of[root] == n) {
+            group_of[root] = groups.size();
+            groups.emplace_back();
+        }
+        groups[group_of[root]].push_back(q);
+    }
+    std::stable_sort(groups.begin(), groups.end(),
+                     [](const auto& a, const auto& b) { return a.size() < b.size(); });
+    return groups;
+}
+
+// If psi = |block⟩ ⊗ |rest⟩, moves the block's state (block[0] most
+// significant) into out and shrinks psi to the remaining qubits in their
+// original order; otherwise leaves psi untouched. Rank-1 test on psi
+// reshaped as block x rest: the row and column through the largest
+// amplitude must reproduce every other amplitude as their product.
+inline bool split(qpp::ket& psi, idx n, const std::vector<idx>& block, qpp::ket& out, double tol = 1e-9) {
+    const std::vector<idx> sub = subsystem_offsets(n, block);
+    const std::vector<idx> rest = subsystem_offsets(n, complement(n, block));
+    const idx mask = sub.back();
+
+    Eigen::Index pivot;
+    psi.cwiseAbs2().maxCoeff(&pivot);
+    const idx p = static_cast<idx>(pivot);
+
+    qpp::ket b_part(sub.size()), r_part(rest.size());
+    for (idx b = 0; b < sub.size(); ++b)
+        b_part(b) = psi(sub[b] | (p & ~mask));
+    for (idx r = 0; r < rest.size(); ++r)
+        r_part(r) = psi((p & mask) | rest[r]) / psi(p);
+
+    double err = 0;
+    for (idx r = 0; r < rest.size(); ++r) {
+        for (idx b = 0; b < sub.size(); ++b)
+            err += std::norm(psi(sub[b] | rest[r]) - b_part(b) * r_part(r));
+        if (err > tol * tol)
+            return false;
+    }
+
+    const double norm = b_part.norm();
+    out = b_part / norm;
+    psi = r_part * norm;
+    return true;
+}
+
+} // namespace kernels
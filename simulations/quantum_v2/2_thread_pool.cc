@@ -0,0 +1,114 @@
+#include "2_thread_pool.h"
+#include "ns3/global-value.h"
+#include "ns3/uinteger.h"
+#include <algorithm>
+#include <pthread.h>
+
+namespace {
+
+ns3::GlobalValue g_quantumThreads("QuantumThreads",
+                                  "Threads used by the state-vector kernels (0: one per core)",
+                                  ns3::UintegerValue(0),
+                                  ns3::MakeUintegerChecker<uint32_t>());
+
+ns3::GlobalValue g_quantumParallelQubits("QuantumParallelQubits",
+                                         "Smallest state, in qubits, whose kernels are split across threads",
+                                         ns3::UintegerValue(18),
+                                         ns3::MakeUintegerChecker<uint32_t>(1, 63));
+
+ThreadPool* g_pool = nullptr;
+
+// The child of a fork() has none of the pool's threads, so its copy of the
+// pool can be neither used nor joined; it is dropped and the child starts
+// its own on first use
+void ForgetPoolInChild() {
+    g_pool = nullptr;
+}
+
+} // namespace
+
+ThreadPool& ThreadPool::instance() {
+    if (!g_pool) {
+        ns3::UintegerValue threads, min_qubits;
+        ns3::GlobalValue::GetValueByName("QuantumThreads", threads);
+        ns3::GlobalValue::GetValueByName("QuantumParallelQubits", min_qubits);
+        configure(threads.Get(), min_qubits.Get());
+    }
+    return *g_pool;
+}
+
+void ThreadPool::configure(size_t threads, size_t min_qubits) {
+    static const bool registered = pthread_atfork(nullptr, nullptr, &ForgetPoolInChild) == 0;
+    (void)registered;
+    delete g_pool;
+    g_pool = new ThreadPool(threads ? threads : std::max(1u, std::thread::hardware_concurrency()), min_qubits);
+}
+
+ThreadPool::ThreadPool(size_t threads, size_t min_qubits) : threads_(threads), min_qubits_(min_qubits) {
+    for (size_t i = 1; i < threads_; ++i)
+        workers_.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& t : workers_)
+        t.join();
+}
+
+size_t ThreadPool::chunks(uint64_t amplitudes) const {
+    if (workers_.empty() || amplitudes < (uint64_t{1} << min_qubits_))
+        return 1;
+    return num_threads();
+}
+
+void ThreadPool::run(uint64_t count, size_t chunks, const Task& task) {
+    if (chunks <= 1 || workers_.empty()) {
+        for (size_t c = 0; c < chunks; ++c)
+            task(c, count * c / chunks, count * (c + 1) / chunks);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        chunks_ = chunks;
+        running_ = workers_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+
+    // Chunks beyond the worker count (chunks > num_threads()) fall to the
+    // calling thread along with the first
+    for (size_t c = 0; c < chunks; c += num_threads())
+        task(c, count * c / chunks, count * (c + 1) / chunks);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return running_ == 0; });
+    task_ = nullptr;
+}
+
+void ThreadPool::work(size_t id) {
+    uint64_t seen = 0;
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_)
+            return;
+        seen = generation_;
+        const Task* task = task_;
+        const uint64_t count = count_;
+        const size_t chunks = chunks_;
+        lock.unlock();
+
+        for (size_t c = id; c < chunks; c += num_threads())
+            (*task)(c, count * c / chunks, count * (c + 1) / chunks);
+
+        lock.lock();
+        if (--running_ == 0)
+            done_.notify_one();
+    }
+}
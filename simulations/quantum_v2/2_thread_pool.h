@@ -0,0 +1,53 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads for the state-vector kernels. A kernel over a state of at
+// least 2^min_qubits() amplitudes is split into one contiguous chunk per
+// thread; smaller states run inline so Bell pairs and the like never pay
+// for synchronization. Sizes come from the QuantumThreads and
+// QuantumParallelQubits global values, read when the pool is first used,
+// or from configure(). A forked child (see TrajectoryRunner) inherits none
+// of the parent's threads, so it starts a pool of its own. Like the rest of
+// a simulation, the pool is driven from one thread.
+class ThreadPool {
+public:
+    // Runs chunk of the split of [0, count) into chunks pieces
+    using Task = std::function<void(size_t chunk, uint64_t begin, uint64_t end)>;
+
+    static ThreadPool& instance();
+    // Replaces the pool; threads = 0 means one per core
+    static void configure(size_t threads, size_t min_qubits);
+
+    size_t num_threads() const { return threads_; }
+    size_t min_qubits() const { return min_qubits_; }
+
+    // How many chunks a kernel over a state of amplitudes entries uses
+    size_t chunks(uint64_t amplitudes) const;
+    // Runs task on each of chunks pieces of [0, count), the calling thread
+    // taking the first, and returns once all are done
+    void run(uint64_t count, size_t chunks, const Task& task);
+
+private:
+    ThreadPool(size_t threads, size_t min_qubits);
+    ~ThreadPool();
+    void work(size_t id);
+
+    const size_t threads_; // workers plus the calling thread
+    const size_t min_qubits_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const Task* task_ = nullptr;
+    uint64_t count_ = 0;
+    size_t chunks_ = 0;
+    uint64_t generation_ = 0;
+    size_t running_ = 0;
+    bool stop_ = false;
+};
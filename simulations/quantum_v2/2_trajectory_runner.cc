@@ -0,0 +1,30 @@
+#include "2_trajectory_runner.h"
+#include "2_replica_runner.h"
+#include "ns3/abort.h"
+#include <string>
+
+TrajectoryRunner::TrajectoryRunner(size_t trajectories, size_t workers)
+    : trajectories_(trajectories), workers_(workers) {}
+
+TrajectoryRunner::Result TrajectoryRunner::run(const Scenario& scenario) const {
+    // Observable i travels as the metric named i
+    ReplicaRunner::Summary summary = ReplicaRunner(trajectories_, workers_).run([&](const ReplicaRunner::Replica& r) {
+        const std::vector<double> x = scenario(r.index);
+        ReplicaRunner::Metrics metrics;
+        for (size_t i = 0; i < x.size(); ++i)
+            metrics[std::to_string(i)] = x[i];
+        return metrics;
+    });
+
+    Result result;
+    result.count = trajectories_;
+    result.mean.resize(summary.size());
+    result.std_error.resize(summary.size());
+    for (const auto& [name, s] : summary) {
+        NS_ABORT_MSG_IF(s.count != trajectories_, "trajectories returned different numbers of observables");
+        const size_t i = std::stoul(name);
+        result.mean[i] = s.mean;
+        result.std_error[i] = s.std_error;
+    }
+    return result;
+}
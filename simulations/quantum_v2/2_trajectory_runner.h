@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Runs a noisy scenario once per Monte Carlo trajectory and averages the
+// observables it returns. Trajectories are ReplicaRunner replicas: each
+// gets its own ns-3 run number and qpp seed, so runs are independent and
+// reproducible, and they are spread over forked worker processes.
+class TrajectoryRunner {
+public:
+    struct Result {
+        std::vector<double> mean;
+        std::vector<double> std_error; // standard error of each mean
+        size_t count = 0;
+    };
+
+    // Takes the trajectory number, returns the observables of that run
+    using Scenario = std::function<std::vector<double>(uint64_t trajectory)>;
+
+    explicit TrajectoryRunner(size_t trajectories, size_t workers = std::thread::hardware_concurrency());
+
+    Result run(const Scenario& scenario) const;
+
+private:
+    size_t trajectories_;
+    size_t workers_;
+};